@@ -1,13 +1,214 @@
 #include "petri.h"
 #include "optimization.h"
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+// Đọc file vector mục tiêu: mỗi dòng một vector gồm num_places số nguyên
+// (cách nhau bởi dấu cách hoặc dấu phẩy), dòng trống và dòng bắt đầu bằng '#' bị bỏ qua
+static bool LoadVectors(const std::string& file, size_t num_places, std::vector<std::vector<int>>& out) {
+    std::ifstream in(file);
+    if (!in) {
+        std::cerr << "[ERROR] Could not open file: " << file << "\n";
+        return false;
+    }
+    std::string line;
+    for (int line_no = 1; std::getline(in, line); ++line_no) {
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream ss(line);
+        std::vector<int> c;
+        std::string tok;
+        bool bad = false;
+        while (ss >> tok) {
+            if (c.empty() && tok[0] == '#') break;
+            try { c.push_back(std::stoi(tok)); } catch (...) { bad = true; break; }
+        }
+        if (c.empty() && !bad) continue;
+        if (bad || c.size() != num_places) {
+            std::cerr << "[WARN] " << file << ":" << line_no << ": expected " << num_places
+                      << " integers, line skipped.\n";
+            continue;
+        }
+        out.push_back(c);
+    }
+    return true;
+}
+
+// In ra kết quả dở dang khi một engine bị dừng vì vượt ngân sách tài nguyên
+static void PrintAborted(const std::string& task, const RunStats& s, long long ms) {
+    std::cout << task << " ABORTED (" << s.reason << ", " << ms << " ms): " << s.states
+              << " states so far, frontier " << s.frontier << ", depth " << s.depth << ".\n";
+}
+
+// Ghi chú cho kết quả Task 5 chỉ tính trên phần không gian trạng thái đã duyệt
+static void PrintPartial(const RunStats& s) {
+    std::cout << "         (explored part only: " << s.reason << ", " << s.states << " states)\n";
+}
+
+// In marking theo các place của net gốc (khi đã rút gọn bằng --reduce)
+static void PrintMarking(const PetriNetAnalysis& app, const Marking& m) {
+    std::cout << "[ ";
+    for (int val : app.reduction.Expand(m)) std::cout << val << " ";
+    std::cout << "]\n";
+}
+
+static void PrintDeadlock(const PetriNetAnalysis& app, const PetriNetAnalysis::DeadlockResult& r,
+                          const std::string& engine) {
+    std::cout << "[Task 4] Deadlock FOUND by " << engine << " (" << r.time_ms << " ms).\n";
+    std::cout << "         Example Deadlock Marking: ";
+    PrintMarking(app, r.deadlock_marking);
+    if (r.count > 0) std::cout << "         Reachable deadlocks: " << r.count << "\n";
+}
+
+#ifndef NO_CUDD
+// In dãy bắn ngắn nhất tìm được từ các vòng BFS của Task 3
+static void PrintTrace(const PetriNetAnalysis& app, const std::string& task, const std::string& what,
+                       const std::vector<int>& trace, const Marking& end) {
+    std::cout << task << " Shortest trace to " << what << " (" << trace.size() << " steps):";
+    for (int t : trace) std::cout << " " << app.reduction.TransitionLabel(t, app.transitions[t].id);
+    std::cout << "\n         Ends at: ";
+    PrintMarking(app, end);
+}
+#endif
+
+// In danh sách bất biến dạng "p1 + 2*p3 = k" (tối đa 20 dòng)
+static void PrintInvariants(const PetriNetAnalysis& app, bool places, const InvariantResult& r) {
+    const char* kind = places ? "P" : "T";
+    size_t n = places ? app.places.size() : app.transitions.size();
+    size_t uncovered = std::count(r.covered.begin(), r.covered.end(), false);
+    std::cout << "[Invariants] " << r.invariants.size() << " minimal " << kind << "-invariants (" << r.time_ms << " ms";
+    if (r.stats.aborted) std::cout << ", INCOMPLETE: " << r.stats.reason;
+    std::cout << "), " << n - uncovered << "/" << n << (places ? " places" : " transitions") << " covered.\n";
+    const size_t shown = 20;
+    for (size_t i = 0; i < r.invariants.size() && i < shown; ++i) {
+        std::cout << "         ";
+        long long value = 0;
+        for (size_t k = 0; k < r.invariants[i].size(); ++k) {
+            int idx = r.invariants[i][k].first;
+            long long w = r.invariants[i][k].second;
+            std::cout << (k ? " + " : "");
+            if (w != 1) std::cout << w << "*";
+            std::cout << (places ? app.places[idx].id : app.transitions[idx].id);
+            if (places) value += w * app.initial_marking[idx];
+        }
+        if (places) std::cout << " = " << value;
+        std::cout << "\n";
+    }
+    if (r.invariants.size() > shown) std::cout << "         ... (" << r.invariants.size() - shown << " more)\n";
+}
+
+// Số nguyên không âm viết đầy đủ bằng chữ số ("1k", "-1", "" đều bị từ chối)
+static bool ParseCount(const char* s, size_t& out) {
+    if (!std::isdigit((unsigned char)*s)) return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long v = std::strtoull(s, &end, 10);
+    if (errno != 0 || *end != '\0' || v > SIZE_MAX) return false;
+    out = (size_t)v;
+    return true;
+}
+
+// Số nguyên có dấu trong khoảng của int
+static bool ParseInt(const char* s, int& out) {
+    const char* digits = (*s == '-' || *s == '+') ? s + 1 : s;
+    if (!std::isdigit((unsigned char)*digits)) return false;
+    char* end = nullptr;
+    errno = 0;
+    long long v = std::strtoll(s, &end, 10);
+    if (errno != 0 || *end != '\0' || v < INT_MIN || v > INT_MAX) return false;
+    out = (int)v;
+    return true;
+}
+
+static void PrintUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [file.pnml] [options]\n"
+              << "  --max-states N  --max-bdd-nodes N  --max-bdd-mem MB  --time-limit S  --max-rss MB\n"
+              << "  --graph FILE  --top-k N  --threshold X  --histogram FILE  --objectives FILE\n"
+              << "  --deadlocks N  --sample N  --trace-to FILE\n"
+              << "  --early-deadlock  --trace  --invariants  --reduce  --compact-bdd\n";
+}
 
 int main(int argc, char* argv[]) {
     // Mặc định chạy file test.pnml nếu không nhập tên file
     std::string filename = "test.pnml";
     
+    // Xuất đồ thị reachability của Task 2 (--graph out.dot hoặc file nhị phân)
+    std::string graph_file;
+    // Giới hạn tài nguyên cho mỗi engine (0 = không giới hạn)
+    ResourceBudget budget = ResourceBudget();
+    // Task 5: k marking tốt nhất (--top-k) và các marking có giá trị >= ngưỡng (--threshold)
+    size_t top_k = 0;
+    bool use_threshold = false;
+    int threshold = 0;
+    // Task 5: phân phối giá trị hàm mục tiêu, ghi ra file CSV (--histogram)
+    std::string histogram_file;
+    // Task 5: file nhiều vector mục tiêu, đánh giá trên cùng một tập reachable (--objectives)
+    std::string objectives_file;
+    // Task 4: liệt kê tối đa N deadlock từ BDD (--deadlocks)
+    size_t deadlock_limit = 0;
+    // Task 3: lấy mẫu ngẫu nhiên đều N marking reachable từ BDD (--sample)
+    size_t sample_count = 0;
+    // Task 3: dừng vòng lặp điểm bất động ở deadlock đầu tiên (--early-deadlock)
+    bool early_deadlock = false;
+    // Dãy bắn ngắn nhất tới một deadlock (--trace) hoặc tới các marking trong file (--trace-to)
+    bool trace_deadlock = false;
+    // Bất biến P/T theo thuật toán Farkas (--invariants)
+    bool run_invariants = false;
+    std::string trace_file;
+    // Rút gọn cấu trúc net trước mọi task (--reduce)
+    bool reduce = false;
+    // Task 3: mã hóa nhị phân các nhóm place của P-invariant 1 token (--compact-bdd)
+    bool compact_bdd = false;
+
     // Nếu người dùng nhập tên file (ví dụ: ./app test_parallel.pnml)
-    if (argc > 1) {
-        filename = argv[1];
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--early-deadlock") early_deadlock = true;
+        else if (arg == "--trace") trace_deadlock = true;
+        else if (arg == "--invariants") run_invariants = true;
+        else if (arg == "--reduce") reduce = true;
+        else if (arg == "--compact-bdd") compact_bdd = true;
+        else if (arg.compare(0, 2, "--") != 0) filename = arg;
+        else {
+            // Các tùy chọn còn lại đều cần một giá trị
+            if (i + 1 >= argc) {
+                std::cerr << "[ERROR] Missing value for " << arg << "\n";
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            const char* value = argv[++i];
+            size_t seconds = 0;
+            bool ok = true;
+            if (arg == "--graph") graph_file = value;
+            else if (arg == "--max-states") ok = ParseCount(value, budget.max_states);
+            else if (arg == "--max-bdd-nodes") ok = ParseCount(value, budget.max_bdd_nodes);
+            else if (arg == "--max-bdd-mem") ok = ParseCount(value, budget.max_bdd_memory_mb);
+            else if (arg == "--time-limit") {
+                ok = ParseCount(value, seconds) && seconds <= (size_t)(LLONG_MAX / 1000);
+                budget.time_limit_ms = (long long)seconds * 1000;
+            }
+            else if (arg == "--max-rss") ok = ParseCount(value, budget.max_rss_mb);
+            else if (arg == "--top-k") ok = ParseCount(value, top_k);
+            else if (arg == "--threshold") { use_threshold = true; ok = ParseInt(value, threshold); }
+            else if (arg == "--histogram") histogram_file = value;
+            else if (arg == "--objectives") objectives_file = value;
+            else if (arg == "--deadlocks") ok = ParseCount(value, deadlock_limit);
+            else if (arg == "--sample") ok = ParseCount(value, sample_count);
+            else if (arg == "--trace-to") trace_file = value;
+            else {
+                std::cerr << "[ERROR] Unknown option: " << arg << "\n";
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            if (!ok) {
+                std::cerr << "[ERROR] Invalid value for " << arg << ": " << value << "\n";
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        }
     }
 
     std::cout << "========================================\n";
@@ -15,6 +216,7 @@ int main(int argc, char* argv[]) {
     std::cout << "========================================\n";
 
     PetriNetAnalysis app;
+    app.budget = budget;
 
     // --- TASK 1: Parsing ---
     if (!app.ParsePNML(filename)) {
@@ -24,55 +226,418 @@ int main(int argc, char* argv[]) {
     }
     app.PrintInfo();
 
+    // Vector mục tiêu theo các place gốc, đọc trước khi rút gọn
+    std::vector<std::vector<int>> objectives;
+    bool objectives_ok = !objectives_file.empty() && LoadVectors(objectives_file, app.places.size(), objectives);
+
+    // --- Coverability: kiểm tra tính bị chặn trước khi chạy các task tốn kém ---
+    // Các thành phần liên thông rời nhau được xét riêng, không duyệt tích của chúng
+    std::vector<NetComponent> components = app.FindComponents();
+    CoverabilityResult cov = components.size() > 1 ? app.ComputeCoverability(components) : app.ComputeCoverability();
+    // Khi coverability bị dừng giữa chừng mà chưa thấy omega thì vẫn chạy các
+    // task sau, chúng tự dừng theo cùng ngân sách
+    bool unbounded = !cov.unbounded_places.empty();
+    if (cov.stats.aborted && !unbounded) {
+        PrintAborted("[Coverability]", cov.stats, cov.time_ms);
+        std::cout << "         Boundedness unknown.\n";
+    } else if (cov.bounded) {
+        int k = 0;
+        for (int b : cov.place_bounds) k = std::max(k, b);
+        std::cout << "[Coverability] Net is " << k << "-bounded (" << cov.nodes << " nodes, "
+                  << cov.time_ms << " ms).\n";
+        if (k > 1) {
+            std::cout << "[WARN] Net is not 1-safe; the BDD encoding of Task 3-5 assumes at most 1 token per place.\n";
+        }
+    } else {
+        std::cout << "[Coverability] Net is UNBOUNDED (" << cov.nodes << " nodes, " << cov.time_ms << " ms).\n";
+        std::cout << "         Unbounded places: ";
+        for (int p : cov.unbounded_places) std::cout << app.place_ids[p] << " ";
+        std::cout << "\n";
+    }
+
+    // --- Bất biến cấu trúc: chỉ dùng ma trận liên thuộc, không duyệt trạng thái.
+    // Tính trên net gốc, trước khi rút gọn (ghép nối tiếp có thể che place không bị chặn) ---
+    if (run_invariants) {
+        InvariantResult pinv = app.ComputePInvariants();
+        PrintInvariants(app, true, pinv);
+        if (!pinv.stats.aborted && !pinv.covered.empty() &&
+            std::find(pinv.covered.begin(), pinv.covered.end(), false) == pinv.covered.end()) {
+            std::cout << "         Net is covered by P-invariants (conservative), hence bounded.\n";
+        }
+        PrintInvariants(app, false, app.ComputeTInvariants());
+    }
+
+    // --- Rút gọn cấu trúc: các task sau chạy trên net nhỏ hơn, kết quả được ánh xạ về net gốc.
+    // Chạy sau coverability vì ghép nối tiếp không giữ tính bị chặn của place bị ghép ---
+    if (reduce) {
+        // Ghép nối tiếp làm mất các marking trung gian: tắt khi cần toàn bộ tập reachable
+        bool exact = top_k > 0 || use_threshold || !histogram_file.empty() || sample_count > 0 ||
+                     trace_deadlock || !trace_file.empty();
+        std::vector<std::vector<int>> kept = objectives;
+        kept.push_back(app.objective_vector);
+        size_t np = app.places.size(), nt = app.transitions.size();
+        app.ReduceNet(kept, exact);
+        const NetReduction& r = app.reduction;
+        std::cout << "[Reduce] " << np << " -> " << app.places.size() << " places, " << nt << " -> "
+                  << app.transitions.size() << " transitions (" << r.constant_places << " constant, "
+                  << r.parallel_places << " parallel, " << r.fused_places << " fused places).\n";
+        if (r.fused_places > 0) {
+            std::cout << "         State counts below are for the reduced net.\n";
+        }
+        // Cận theo từng place của net rút gọn
+        if (!cov.place_bounds.empty()) {
+            std::vector<int> bounds(app.places.size(), 0);
+            for (size_t p = 0; p < r.place_kept.size(); ++p) {
+                if (r.place_kept[p]) bounds[r.place_base[p]] = cov.place_bounds[p];
+            }
+            cov.place_bounds.swap(bounds);
+        }
+    }
+
+    // Cận từng place chỉ dùng được khi coverability chạy hết: khi bị dừng giữa
+    // chừng, các giá trị lớn nhất đã gặp có thể nhỏ hơn cận thật
+    std::vector<int> place_bounds;
+    if (!cov.stats.aborted) place_bounds = cov.place_bounds;
+
     // --- TASK 2: Explicit Reachability ---
-    long long t2;
-    auto res2 = app.ComputeExplicit(t2);
-    std::cout << "[Task 2] Explicit Reachability: " << res2.size() 
-              << " markings (" << t2 << " ms).\n";
+    long long t2 = 0;
+    ReachabilityGraph graph;
+    RunStats stats2 = RunStats();
+    StateStore res2;
+    std::vector<uint64_t> fired2;
+    // Net gồm nhiều thành phần rời nhau: tập reachable là tích Descartes của
+    // các thành phần, mỗi thành phần được duyệt riêng (song song) rồi ghép lại.
+    // Đồ thị reachability (--graph) vẫn cần duyệt cả tích.
+    if (app.reduction.Active()) components = app.FindComponents();
+    bool split = !unbounded && components.size() > 1 && graph_file.empty();
+    ComponentResult comp = ComponentResult();
+    if (split) {
+        comp = app.AnalyzeComponents(components, app.objective_vector);
+        stats2 = comp.stats;
+        fired2 = comp.fired;
+        double largest = *std::max_element(comp.states.begin(), comp.states.end());
+        if (comp.stats.aborted) {
+            PrintAborted("[Task 2] Explicit Reachability", comp.stats, comp.time_ms);
+        } else {
+            std::cout << "[Task 2] Explicit Reachability: " << comp.total_states << " markings (" << comp.time_ms
+                      << " ms).\n";
+        }
+        std::cout << "         Product of " << components.size() << " independent components, largest "
+                  << largest << " markings.\n";
+    } else if (!unbounded) {
+        res2 = app.ComputeExplicit(t2, graph_file.empty() ? nullptr : &graph, &stats2, &fired2);
+        if (stats2.aborted) {
+            PrintAborted("[Task 2] Explicit Reachability", stats2, t2);
+        } else {
+            std::cout << "[Task 2] Explicit Reachability: " << res2.size() 
+                      << " markings (" << t2 << " ms).\n";
+        }
+    } else {
+        std::cout << "[Task 2] Explicit Reachability: Skipped (infinite state space).\n";
+    }
+    if (!unbounded && !graph_file.empty()) {
+        bool dot = graph_file.size() >= 4 && graph_file.compare(graph_file.size() - 4, 4, ".dot") == 0;
+        bool ok = dot ? graph.WriteDot(graph_file, app.places, app.transitions, res2)
+                      : graph.WriteBinary(graph_file);
+        if (ok) {
+            std::cout << "         Reachability graph: " << graph.NumStates() << " states, "
+                      << graph.NumEdges() << " edges -> " << graph_file << "\n";
+            if (graph.expanded < graph.NumStates()) {
+                std::cout << "         " << graph.NumStates() - graph.expanded
+                          << " states reached but not expanded (no outgoing edges recorded).\n";
+            }
+        }
+    }
 
     // --- TASK 3: Symbolic Reachability ---
     long long t3;
-    DdNode* res3 = app.ComputeSymbolic(t3);
+    RunStats stats3 = RunStats();
+    app.keep_rings = trace_deadlock || !trace_file.empty();
+    app.compact_encoding = compact_bdd;
+    PetriNetAnalysis::DeadlockResult early = PetriNetAnalysis::DeadlockResult();
+    DdNode* res3 = app.ComputeSymbolic(t3, &stats3, early_deadlock ? &early : nullptr);
 #ifndef NO_CUDD
     double num_states = app.bdd_mgr.CountStates(res3);
     int bdd_nodes = Cudd_DagSize(res3);
-    std::cout << "[Task 3] Symbolic Reachability: " << num_states << " markings (" << t3 << " ms).\n";
+    if (early.found) {
+        std::cout << "[Task 3] Symbolic Reachability: stopped at the first deadlock, depth " << early.stats.depth
+                  << ", " << num_states << " markings so far (" << t3 << " ms).\n";
+    } else if (stats3.aborted) {
+        PrintAborted("[Task 3] Symbolic Reachability", stats3, t3);
+    } else {
+        std::cout << "[Task 3] Symbolic Reachability: " << num_states << " markings (" << t3 << " ms).\n";
+    }
     std::cout << "         Memory Complexity: " << bdd_nodes << " BDD nodes.\n";
+    if (compact_bdd) {
+        std::cout << "         Compact encoding: " << app.bdd_mgr.NumBlocks() << " one-token blocks, "
+                  << app.bdd_mgr.NumVars() << " variables for " << app.places.size() << " places.\n";
+    }
 #else
     std::cout << "[Task 3] Symbolic Reachability: Disabled (No CUDD).\n";
 #endif
-    // --- TASK 4: Deadlock Detection --- 
+    // Chỉ dùng BDD khi tập reachable đầy đủ
+    DdNode* reach_bdd = stats3.aborted ? nullptr : res3;
+
+    // Transition chết (L0, không bao giờ bắn được): từ BDD khi tập reachable đầy
+    // đủ, nếu không thì từ các transition đã bật được trong Task 2
+    std::vector<int> dead_trans;
+    std::string dead_engine;
 #ifndef NO_CUDD
-    auto deadlock_res = app.DetectDeadlock(res3);
-    
-    if (deadlock_res.found) {
-        std::cout << "[Task 4] Deadlock FOUND (" << deadlock_res.time_ms << " ms).\n";
-        std::cout << "         Example Deadlock Marking: [ ";
-        for (int val : deadlock_res.deadlock_marking) {
-            std::cout << val << " ";
+    if (reach_bdd && app.FindDeadTransitions(reach_bdd, dead_trans)) dead_engine = "BDD";
+#endif
+    if (dead_engine.empty() && !fired2.empty()) {
+        for (size_t t = 0; t < app.transitions.size(); ++t) {
+            if (!(fired2[t / 64] >> (t % 64) & 1)) dead_trans.push_back((int)t);
         }
-        std::cout << "]\n";
-    } else {
-        std::cout << "[Task 4] No deadlock detected (" << deadlock_res.time_ms << " ms).\n";
+        dead_engine = stats2.aborted ? "explicit, explored part only" : "explicit";
+    }
+    if (!dead_engine.empty()) {
+        std::cout << "[Task 3] Dead transitions (" << dead_engine << "): " << dead_trans.size() << " of "
+                  << app.transitions.size();
+        if (!dead_trans.empty()) {
+            std::cout << " [ ";
+            for (int t : dead_trans) std::cout << app.reduction.TransitionLabel(t, app.transitions[t].id) << " ";
+            std::cout << "]";
+        }
+        std::cout << "\n";
+    }
+#ifndef NO_CUDD
+    if (sample_count > 0 && reach_bdd) {
+        std::random_device rd;
+        std::vector<Marking> samples = app.bdd_mgr.SampleMarkings(reach_bdd, sample_count, rd());
+        std::cout << "[Task 3] " << samples.size() << " markings sampled uniformly:\n";
+        for (const Marking& m : samples) {
+            std::cout << "         ";
+            PrintMarking(app, m);
+        }
+    }
+    std::vector<std::vector<int>> trace_targets;
+    size_t trace_places = app.reduction.Active() ? app.reduction.place_base.size() : app.places.size();
+    if (!trace_file.empty() && LoadVectors(trace_file, trace_places, trace_targets)) {
+        // Mục tiêu là hợp của các marking trong file
+        DdNode* target = app.bdd_mgr.GetZero();
+        app.bdd_mgr.Ref(target);
+        for (const Marking& orig : trace_targets) {
+            Marking m;
+            if (!app.reduction.Project(orig, m)) continue;  // trái với net đã rút gọn: không reachable
+            DdNode* one = app.bdd_mgr.BuildMarkingBDD(m);
+            DdNode* u = one ? app.bdd_mgr.BDD_Or(target, one) : nullptr;
+            app.bdd_mgr.Deref(one);
+            app.bdd_mgr.Deref(target);
+            target = u;
+            if (!target) break;
+        }
+        std::vector<int> trace;
+        Marking end;
+        if (app.ShortestTrace(target, trace, &end)) {
+            PrintTrace(app, "[Task 3]", trace_file, trace, end);
+        } else if (stats3.aborted) {
+            std::cout << "[Task 3] No marking of " << trace_file << " in the explored part (inconclusive).\n";
+        } else {
+            std::cout << "[Task 3] No marking of " << trace_file << " is reachable.\n";
+        }
+        app.bdd_mgr.Deref(target);
     }
 #else
-    std::cout << "[Task 4] Deadlock Detection: Disabled (No CUDD).\n";
+    if (sample_count > 0) std::cout << "[WARN] --sample needs CUDD.\n";
+    if (trace_deadlock || !trace_file.empty()) std::cout << "[WARN] --trace needs CUDD.\n";
 #endif
 
-    //TASK 5
+    // --- TASK 4: Deadlock Detection --- 
+    bool deadlock_done = false;
+    // Deadlock của net = deadlock của mọi thành phần cùng lúc
+    if (split && comp.deadlock) {
+        PetriNetAnalysis::DeadlockResult r = PetriNetAnalysis::DeadlockResult();
+        r.found = true;
+        r.deadlock_marking = comp.deadlock_marking;
+        r.time_ms = comp.time_ms;
+        if (!comp.stats.aborted) r.count = comp.deadlocks;
+        PrintDeadlock(app, r, "component product");
+        deadlock_done = true;
+    } else if (split && comp.deadlock_free) {
+        std::cout << "[Task 4] No deadlock: a component has no dead marking (" << comp.time_ms << " ms).\n";
+        deadlock_done = true;
+    }
+#ifndef NO_CUDD
+    if (early.found) {
+        PrintDeadlock(app, early, "on-the-fly BDD");
+        std::cout << "         First reached at BFS depth " << early.stats.depth << ".\n";
+        deadlock_done = true;
+    }
+#endif
+#ifdef USE_GLPK
+    // Kiểm tra cấu trúc siphon-trap: mọi siphon tối tiểu chứa một trap có token
+    // ban đầu thì không có deadlock, không cần đến không gian trạng thái
+    if (!deadlock_done) {
+        auto st_res = app.CheckSiphonTrap();
+        if (!st_res.stats.aborted) {
+            std::cout << "[Task 4] No deadlock: proven structurally (siphon-trap property, " << st_res.stats.depth
+                      << " minimal siphons, " << st_res.time_ms << " ms).\n";
+            deadlock_done = true;
+        } else {
+            std::cout << "[Task 4] Siphon-trap check inconclusive (" << st_res.stats.reason << ").\n";
+        }
+    }
+    // Phương trình trạng thái + ILP trên toàn net: chứng minh không có deadlock
+    // mà không cần không gian trạng thái, chỉ kiểm tra lại khi có ứng viên
+    if (!unbounded && !deadlock_done) {
+        auto ilp_res = app.DetectDeadlockILP(place_bounds, reach_bdd);
+        if (ilp_res.found) {
+            PrintDeadlock(app, ilp_res, "state equation ILP");
+            deadlock_done = true;
+        } else if (!ilp_res.stats.aborted) {
+            std::cout << "[Task 4] No deadlock: proven by state equation ILP (" << ilp_res.stats.depth
+                      << " rounds, " << ilp_res.time_ms << " ms).\n";
+            deadlock_done = true;
+        } else {
+            std::cout << "[Task 4] State equation ILP inconclusive (" << ilp_res.stats.reason << ").\n";
+        }
+    }
+#endif
 #ifndef NO_CUDD
-    auto opt = MarkingOptimizerBB::maxReachableMarking(app.place_ids, res3, app.objective_vector, app);
+    if (!deadlock_done) {
+        auto deadlock_res = app.DetectDeadlock(res3);
+
+        if (deadlock_res.found) {
+            PrintDeadlock(app, deadlock_res, "BDD");
+        } else if (stats3.aborted || deadlock_res.stats.aborted) {
+            // Tập reachable chưa đầy đủ nên không kết luận được
+            std::cout << "[Task 4] No deadlock in the explored part (inconclusive, " << deadlock_res.time_ms << " ms).\n";
+        } else {
+            std::cout << "[Task 4] No deadlock detected (" << deadlock_res.time_ms << " ms).\n";
+        }
+    }
+    // Đếm và liệt kê các deadlock trực tiếp từ các cube của BDD
+    if (deadlock_limit > 0 && reach_bdd) {
+        std::vector<Marking> deadlocks;
+        double n = app.EnumerateDeadlocks(reach_bdd, deadlock_limit,
+                                          [&](const Marking& m) { deadlocks.push_back(m); return true; });
+        if (n < 0) {
+            std::cout << "[Task 4] Deadlock enumeration aborted (" << app.bdd_mgr.BudgetError() << ").\n";
+        } else {
+            std::cout << "[Task 4] " << n << " reachable deadlocks, listing " << deadlocks.size() << ":\n";
+            for (const Marking& m : deadlocks) {
+                std::cout << "         ";
+                PrintMarking(app, m);
+            }
+        }
+    }
+    if (trace_deadlock) {
+        DdNode* dead_mask = app.bdd_mgr.BuildDeadlockMask(app.input_matrix);
+        std::vector<int> trace;
+        Marking end;
+        if (app.ShortestTrace(dead_mask, trace, &end)) PrintTrace(app, "[Task 4]", "a deadlock", trace, end);
+        else std::cout << "[Task 4] No deadlock trace (no deadlock in the explored part).\n";
+        app.bdd_mgr.Deref(dead_mask);
+    }
 #else
-    auto opt = MarkingOptimizerBB::maxReachableMarking(app.place_ids, nullptr, app.objective_vector, app);
+    if (!deadlock_done) std::cout << "[Task 4] Deadlock Detection: Disabled (No CUDD).\n";
+    if (deadlock_limit > 0) std::cout << "[WARN] --deadlocks needs CUDD.\n";
 #endif
 
-    if (opt.first.empty()) {
-        std::cout << "[Task 5] Optimization: No reachable marking found.\n";
-    } else {
-        std::cout << "[Task 5] Optimal value = " << opt.second << "\n";
-        std::cout << "         Marking = [ ";
-        for (int v : opt.first) std::cout << v << " ";
-        std::cout << "]\n";
+    //TASK 5
+    if (unbounded) {
+        std::cout << "[Task 5] Optimization: Skipped (net is unbounded).\n";
+        return 0;
+    }
+    // Phần hằng của hàm mục tiêu do các place đã bị rút gọn
+    long long offset = app.reduction.objective_offset;
+    bool solved = false;
+    // Tối ưu của net = tổng tối ưu của các thành phần
+    if (split && !comp.stats.aborted) {
+        std::cout << "[Task 5] Optimal value = " << comp.optimum + offset << " (sum over " << components.size()
+                  << " components)\n";
+        std::cout << "         Marking = ";
+        PrintMarking(app, comp.optimum_marking);
+        solved = true;
+    }
+#ifdef USE_GLPK
+    // BDD không đầy đủ: dùng phương trình trạng thái + ILP
+    if (!solved && !reach_bdd) {
+        StateEquationResult se = MarkingOptimizerBB::maxByStateEquation(
+            app.objective_vector, app, res3, place_bounds);
+        if (se.exact) {
+            std::cout << "[Task 5] Optimal value = " << se.value + offset << " (state equation ILP, "
+                      << se.rounds << " rounds, " << se.time_ms << " ms)\n";
+        } else {
+            std::cout << "[Task 5] Best reachable value = " << se.value + offset;
+            if (se.has_bound) std::cout << ", upper bound " << se.upper_bound + offset;
+            std::cout << " (state equation ILP, " << se.rounds << " rounds, " << se.time_ms << " ms)\n";
+        }
+        std::cout << "         Marking = ";
+        PrintMarking(app, se.marking);
+        solved = true;
+    }
+#endif
+    if (!solved) {
+        bool optimal = true;
+        auto opt = MarkingOptimizerBB::maxReachableMarking(app.place_ids, res3, app.objective_vector, app,
+                                                           place_bounds, &optimal);
+
+        if (opt.first.empty()) {
+            std::cout << "[Task 5] Optimization: No reachable marking found.\n";
+        } else {
+            std::cout << "[Task 5] Optimal value = " << opt.second + offset;
+            if (!optimal || (res3 && stats3.aborted)) std::cout << " (lower bound, state space incomplete)";
+            std::cout << "\n";
+            std::cout << "         Marking = ";
+            PrintMarking(app, opt.first);
+        }
     }
 
+    // In từng kết quả ngay khi nhận được, không giữ cả tập kết quả trong bộ nhớ
+    size_t count = 0;
+    auto print = [&](const std::vector<int>& m, int val) {
+        std::cout << "         #" << ++count << " value = " << val + offset << "  ";
+        PrintMarking(app, m);
+        return true;
+    };
+    // Các truy vấn không dùng được BDD dùng chung tập explicit của Task 2 (res2);
+    // nếu Task 2 chạy theo thành phần thì tập tích được duyệt ở truy vấn đầu tiên
+    bool complete = true;
+    if (top_k > 0) {
+        std::cout << "[Task 5] Top " << top_k << " markings:\n";
+        MarkingOptimizerBB::topKReachable(reach_bdd, app.objective_vector, top_k, app, print, res2, stats2,
+                                          &complete);
+        if (!complete) PrintPartial(stats2);
+    }
+    if (use_threshold) {
+        std::cout << "[Task 5] Markings with value >= " << threshold << ":\n";
+        count = 0;
+        long long shifted = std::max<long long>(INT_MIN, std::min<long long>(INT_MAX, threshold - offset));
+        MarkingOptimizerBB::thresholdReachable(reach_bdd, app.objective_vector, (int)shifted, app, print,
+                                               res2, stats2, &complete);
+        std::cout << "         " << count << " markings.\n";
+        if (!complete) PrintPartial(stats2);
+    }
+    if (objectives_ok) {
+        std::vector<long long> offsets(objectives.size(), 0);
+        for (size_t v = 0; v < objectives.size(); ++v) {
+            objectives[v] = app.reduction.MapObjective(objectives[v], offsets[v]);
+        }
+        auto t_start = std::chrono::high_resolution_clock::now();
+        auto batch = MarkingOptimizerBB::maxReachableBatch(reach_bdd, objectives, app, res2, stats2, &complete);
+        auto t_end = std::chrono::high_resolution_clock::now();
+        std::cout << "[Task 5] " << batch.size() << " objective vectors from " << objectives_file << " ("
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_start).count() << " ms):\n";
+        for (size_t v = 0; v < batch.size(); ++v) {
+            std::cout << "         #" << v + 1 << " value = " << batch[v].second + offsets[v] << "  ";
+            PrintMarking(app, batch[v].first);
+        }
+        if (!complete) PrintPartial(stats2);
+    }
+    if (!histogram_file.empty()) {
+        auto hist = MarkingOptimizerBB::objectiveHistogram(reach_bdd, app.objective_vector, app, res2, stats2,
+                                                           &complete);
+        std::ofstream csv(histogram_file);
+        if (!csv) {
+            std::cerr << "[ERROR] Could not write file: " << histogram_file << "\n";
+        } else {
+            csv << "value,count\n" << std::fixed << std::setprecision(0);
+            for (const auto& h : hist) csv << h.first + offset << "," << h.second << "\n";
+            std::cout << "[Task 5] Objective histogram: " << hist.size() << " distinct values -> "
+                      << histogram_file << "\n";
+            if (!complete) PrintPartial(stats2);
+        }
+    }
 }
\ No newline at end of file
@@ -4,11 +4,14 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <queue>
 #include <chrono>
 #include <algorithm>
 #include <fstream>
+#include <cstdint>
+#include <climits>
 
 #include "tinyxml2.h"
 
@@ -3,114 +3,580 @@
 #include <set>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 
-static int dotProduct(const std::vector<int>& m, const std::vector<int>& c) {
+static int dotProduct(const int* m, size_t len, const std::vector<int>& c) {
     int s = 0;
-    size_t n = std::min(m.size(), c.size());
+    size_t n = std::min(len, c.size());
     for (size_t i = 0; i < n; ++i) s += m[i] * c[i];
     return s;
 }
 
-// lấy một marking đại diện từ BDD rồi flip một số bit,
-// kiểm tra vẫn thuộc reachable set.
-static bool pickNextMarkingCandidates(BDDWrapper& mgr,
-                                      DdNode* set_bdd,
-                                      std::vector<std::vector<int>>& out_candidates,
-                                      int limit = 64) 
-{
+// Explicit fallback over the shared store (usually the one of Task 2); an
+// empty store is explored here once and kept for the next query
+static const StateStore& SharedStates(PetriNetAnalysis& app, StateStore& reachable, RunStats& stats,
+                                      bool* complete) {
+    if (reachable.size() == 0) {
+        long long t_ms = 0;
+        reachable = app.ComputeExplicit(t_ms, nullptr, &stats);
+    }
+    if (complete) *complete = !stats.aborted;
+    return reachable;
+}
+
 #ifndef NO_CUDD
-    Marking base = mgr.PickOneMarking(set_bdd);
-    if (base.empty()) return false;
+namespace {
+const long long NEG_INF = LLONG_MIN / 4;
+
+// A set-of-markings BDD copied once into an array, children before parents,
+// so that any number of objectives can be evaluated by linear passes without
+// touching the manager. An edge is (node id << 1 | complement bit); node 0 is
+// the constant, so edge 0 is true and edge 1 is false.
+struct FlatBDD {
+    struct Node { int rank; uint32_t then_edge, else_edge; };
+    std::vector<int> order;         // rank -> place, by current level
+    std::vector<Node> nodes;
+    uint32_t root = 1;
+    bool ok = true;                 // false if a next-state variable or a block bit shows up
+
+    FlatBDD(BDDWrapper& mgr, DdNode* f) : order(mgr.PlacesByLevel()) {
+        // A block of places shares its variables (compact encoding), so a
+        // node no longer stands for one place
+        if (mgr.NumBlocks()) { ok = false; return; }
+        std::vector<int> rank(order.size());
+        for (size_t k = 0; k < order.size(); ++k) rank[order[k]] = (int)k;
+        std::unordered_map<DdNode*, uint32_t> ids;
+        nodes.push_back({(int)order.size(), 0, 0});
+        ids[Cudd_Regular(Cudd_ReadOne(mgr.manager))] = 0;
+        root = Add(mgr, rank, ids, f);
+    }
 
-    out_candidates.push_back(base);
-    if (limit <= 1) return true;
+    uint32_t Add(BDDWrapper& mgr, const std::vector<int>& rank,
+                 std::unordered_map<DdNode*, uint32_t>& ids, DdNode* f) {
+        DdNode* r = Cudd_Regular(f);
+        uint32_t c = Cudd_IsComplement(f) ? 1 : 0;
+        auto it = ids.find(r);
+        if (it != ids.end()) return it->second << 1 | c;
+        int p = mgr.PlaceOfVar(Cudd_NodeReadIndex(r));
+        if (p < 0) { ok = false; return 1; }
+        uint32_t t = Add(mgr, rank, ids, Cudd_T(r));
+        uint32_t e = Add(mgr, rank, ids, Cudd_E(r));
+        uint32_t id = (uint32_t)nodes.size();
+        nodes.push_back({rank[p], t, e});
+        ids[r] = id;
+        return id << 1 | c;
+    }
+
+    int Rank(uint32_t e) const { return nodes[e >> 1].rank; }
+    bool IsConstant(uint32_t e) const { return (e >> 1) == 0; }
+    uint32_t Then(uint32_t e) const { return nodes[e >> 1].then_edge ^ (e & 1); }
+    uint32_t Else(uint32_t e) const { return nodes[e >> 1].else_edge ^ (e & 1); }
+};
 
-    int n = (int)base.size();
-    int produced = 1;
+// Longest path to the true terminal for one objective. Taking the then-edge of
+// the node for place p earns c[p]; a place whose variable is skipped by an
+// edge is free, so it earns max(0, c[p]). Ranks follow levels, which makes the
+// places skipped by an edge a contiguous rank range summed with a prefix
+// array. One pass over the node array solves both polarities of every node,
+// so a query is linear in the BDD size.
+struct LongestPath {
+    const FlatBDD& g;
+    std::vector<long long> coef;    // rank -> objective coefficient
+    std::vector<long long> gain;    // gain[k] = sum of max(0, coef) over ranks < k
+    std::vector<long long> best;    // per edge
 
-    for (int i = 0; i < n && produced < limit; ++i) {
-        std::vector<int> neighb= base;
-        neighb[i] = 1 - neighb[i]; // flip bit
+    LongestPath(const FlatBDD& flat, const std::vector<int>& c) : g(flat) {
+        size_t n = g.order.size();
+        coef.resize(n); gain.assign(n + 1, 0);
+        for (size_t k = 0; k < n; ++k) {
+            coef[k] = (size_t)g.order[k] < c.size() ? c[g.order[k]] : 0;
+            gain[k + 1] = gain[k] + std::max(0LL, coef[k]);
+        }
+        best.resize(2 * g.nodes.size());
+        best[0] = 0;
+        best[1] = NEG_INF;
+        for (uint32_t e = 2; e < best.size(); ++e) best[e] = std::max(Value(e, true), Value(e, false));
+    }
+
+    // Skipped places strictly between rank `from` and rank `to`
+    long long Skipped(int from, int to) const { return gain[to] - gain[from + 1]; }
+
+    // Best completion through the then (or else) branch of non-constant edge e
+    long long Value(uint32_t e, bool then_branch) const {
+        int k = g.Rank(e);
+        uint32_t child = then_branch ? g.Then(e) : g.Else(e);
+        if (best[child] == NEG_INF) return NEG_INF;
+        return best[child] + (then_branch ? coef[k] : 0) + Skipped(k, g.Rank(child));
+    }
 
-        DdNode* m_bdd = mgr.BuildMarkingBDD(neighb); mgr.Ref(m_bdd);
-        DdNode* inter = Cudd_bddAnd(mgr.manager, set_bdd, m_bdd); mgr.Ref(inter);
-        bool ok = (inter != Cudd_ReadLogicZero(mgr.manager));
-        mgr.Deref(m_bdd);
-        mgr.Deref(inter);
+    // Best value over all paths of e, counting the free places above it
+    long long Bound(uint32_t e, int k) const {
+        return best[e] == NEG_INF ? NEG_INF : best[e] + gain[g.Rank(e)] - gain[k];
+    }
 
-        if (ok) {
-            out_candidates.push_back(neighb);
-            produced++;
+    // Follows the optimal branches from `root` and fills in the marking
+    Marking Decode(uint32_t root) const {
+        Marking m(g.order.size(), 0);
+        int k = -1;
+        for (uint32_t e = root;;) {
+            int next = g.Rank(e);
+            for (int j = k + 1; j < next; ++j) if (coef[j] > 0) m[g.order[j]] = 1;
+            if (g.IsConstant(e)) break;
+            if (Value(e, true) >= Value(e, false)) { m[g.order[next]] = 1; e = g.Then(e); } else { e = g.Else(e); }
+            k = next;
         }
+        return m;
     }
+};
+
+// max c·m over a set through the objective ADD, for the compact encoding that
+// FlatBDD cannot read; best = NEG_INF on an empty set. False if a limit was hit.
+bool AddMaximum(BDDWrapper& mgr, DdNode* set, const std::vector<int>& c, long long& best, Marking& arg) {
+    DdManager* dd = mgr.manager;
+    double minus_inf = Cudd_V(Cudd_ReadMinusInfinity(dd));
+    DdNode* obj = mgr.BuildObjectiveADD(c);
+    DdNode* in_set = obj ? Cudd_BddToAdd(dd, set) : nullptr;
+    if (in_set) Cudd_Ref(in_set);
+    DdNode* f = in_set ? Cudd_addIte(dd, in_set, obj, Cudd_ReadMinusInfinity(dd)) : nullptr;
+    if (f) Cudd_Ref(f);
+    DdNode* top = f ? Cudd_addFindMax(dd, f) : nullptr;
+    DdNode* at_top = (top && Cudd_V(top) != minus_inf) ? Cudd_addBddThreshold(dd, f, Cudd_V(top)) : nullptr;
+    if (at_top) Cudd_Ref(at_top);
 
-    return true;
-#else
-    return false;
+    bool ok = top && (at_top || Cudd_V(top) == minus_inf);
+    best = NEG_INF;
+    if (at_top) {
+        best = std::llround(Cudd_V(top));
+        arg = mgr.PickOneMarking(at_top);
+    }
+    if (obj) Cudd_RecursiveDeref(dd, obj);
+    if (in_set) Cudd_RecursiveDeref(dd, in_set);
+    if (f) Cudd_RecursiveDeref(dd, f);
+    if (at_top) Cudd_RecursiveDeref(dd, at_top);
+    return ok;
+}
+}
 #endif
+
+#ifdef USE_GLPK
+// State equation with objective c·m
+static glp_prob* BuildStateEquation(const PetriNetAnalysis& app, const std::vector<int>& objective_vector,
+                                    const std::vector<int>& place_bounds) {
+    glp_prob* lp = app.BuildStateEquation(place_bounds);
+    for (size_t p = 0; p < app.places.size() && p < objective_vector.size(); ++p) {
+        glp_set_obj_coef(lp, (int)p + 1, objective_vector[p]);
+    }
+    return lp;
 }
 
+// Upper bound on c·m over the reachable set from the LP relaxation of the
+// state equation; it already implies every P-invariant constraint
+static bool StateEquationBound(const PetriNetAnalysis& app, const std::vector<int>& objective_vector,
+                               const std::vector<int>& place_bounds, long long& bound) {
+    glp_prob* lp = BuildStateEquation(app, objective_vector, place_bounds);
+    glp_smcp smcp;
+    glp_init_smcp(&smcp);
+    smcp.msg_lev = GLP_MSG_OFF;
+    bool ok = glp_simplex(lp, &smcp) == 0 && glp_get_status(lp) == GLP_OPT;
+    // c and m are integral, so the bound can be rounded down
+    if (ok) bound = (long long)std::floor(glp_get_obj_val(lp) + 1e-6);
+    glp_delete_prob(lp);
+    return ok;
+}
+#endif
+
 std::pair<std::vector<int>, int>
 MarkingOptimizerBB::maxReachableMarking(const std::vector<std::string>& place_ids,
                                         DdNode* reachable_bdd,
                                         const std::vector<int>& objective_vector,
-                                        PetriNetAnalysis& app) 
+                                        PetriNetAnalysis& app,
+                                        const std::vector<int>& place_bounds,
+                                        bool* optimal)
 {
     int best_val = INT_MIN;
     std::vector<int> best_marking;
 
 #ifndef NO_CUDD
     if (reachable_bdd) {
-        std::vector<std::vector<int>> candidates;
-        bool ok = pickNextMarkingCandidates(app.bdd_mgr, reachable_bdd, candidates, 128);
-
-        if (ok && !candidates.empty()) {
-            for (const auto& m : candidates) {
-                int val = dotProduct(m, objective_vector);
-                if (val > best_val) {
-                    best_val = val;
-                    best_marking = m;
-                }
+        FlatBDD flat(app.bdd_mgr, reachable_bdd);
+        if (flat.ok) {
+            LongestPath lp(flat, objective_vector);
+            long long best = lp.Bound(flat.root, 0);
+            if (optimal) *optimal = true;
+            if (best == NEG_INF) return { {}, INT_MIN };
+            return { lp.Decode(flat.root), (int)best };
+        }
+        // Mã hóa gọn (--compact-bdd): lấy max trên ADD của hàm mục tiêu
+        long long best;
+        std::vector<int> arg;
+        if (app.bdd_mgr.NumBlocks() && AddMaximum(app.bdd_mgr, reachable_bdd, objective_vector, best, arg)) {
+            if (optimal) *optimal = true;
+            if (best == NEG_INF) return { {}, INT_MIN };
+            return { arg, (int)best };
+        }
+        // BDD còn chứa biến x' (không phải tập marking), fallback xuống explicit
+    }
+#endif
+
+    // Cận trên: place bị chặn (coverability) và LP relaxation của phương trình trạng thái
+    long long bound = 0;
+    for (size_t p = 0; p < objective_vector.size() && p < app.places.size(); ++p) {
+        if (objective_vector[p] <= 0) continue;
+        if (p >= place_bounds.size() || place_bounds[p] == OMEGA) { bound = LLONG_MAX; break; }
+        bound += (long long)objective_vector[p] * place_bounds[p];
+    }
+#ifdef USE_GLPK
+    long long lp_bound;
+    if (StateEquationBound(app, objective_vector, place_bounds, lp_bound)) bound = std::min(bound, lp_bound);
+#endif
+
+    long long best = 0;
+    bool proven = false;
+    best_marking = app.ExploreMax(objective_vector, bound, best, proven);
+    best_val = (int)best;
+    if (optimal) *optimal = proven;
+
+    if (best_val == INT_MIN) {
+        return { {}, INT_MIN };
+    }
+    return { best_marking, best_val };
+}
+
+std::vector<std::pair<std::vector<int>, int>>
+MarkingOptimizerBB::maxReachableBatch(DdNode* reachable_bdd,
+                                      const std::vector<std::vector<int>>& objectives,
+                                      PetriNetAnalysis& app,
+                                      StateStore& states,
+                                      RunStats& states_stats,
+                                      bool* complete)
+{
+    std::vector<std::pair<std::vector<int>, int>> results;
+    if (complete) *complete = true;
+    if (objectives.empty()) return results;
+#ifndef NO_CUDD
+    if (reachable_bdd) {
+        FlatBDD flat(app.bdd_mgr, reachable_bdd);
+        if (flat.ok) {
+            for (const auto& c : objectives) {
+                LongestPath lp(flat, c);
+                long long best = lp.Bound(flat.root, 0);
+                if (best == NEG_INF) results.push_back({ {}, INT_MIN });
+                else results.push_back({ lp.Decode(flat.root), (int)best });
             }
-        } else {
-            Marking base = app.bdd_mgr.PickOneMarking(reachable_bdd);
-            if (!base.empty()) {
-                int n = (int)base.size();
-                for (int i = 0; i < n; ++i) {
-                    std::vector<int> m1 = base; m1[i] = 1 - m1[i];
-                    DdNode* m_bdd = app.bdd_mgr.BuildMarkingBDD(m1); app.bdd_mgr.Ref(m_bdd);
-                    DdNode* inter = Cudd_bddAnd(app.bdd_mgr.manager, reachable_bdd, m_bdd); app.bdd_mgr.Ref(inter);
-                    if (inter != Cudd_ReadLogicZero(app.bdd_mgr.manager)) {
-                        int val = dotProduct(m1, objective_vector);
-                        if (val > best_val) { best_val = val; best_marking = m1; }
-                    }
-                    app.bdd_mgr.Deref(m_bdd);
-                    app.bdd_mgr.Deref(inter);
-                }
-                int val_base = dotProduct(base, objective_vector);
-                if (val_base > best_val) { best_val = val_base; best_marking = base; }
+            return results;
+        }
+        if (app.bdd_mgr.NumBlocks()) {
+            bool ok = true;
+            for (size_t v = 0; v < objectives.size() && ok; ++v) {
+                long long best;
+                std::vector<int> arg;
+                ok = AddMaximum(app.bdd_mgr, reachable_bdd, objectives[v], best, arg);
+                if (best == NEG_INF) results.push_back({ {}, INT_MIN });
+                else results.push_back({ arg, (int)best });
             }
+            if (ok) return results;
+            results.clear();
+        }
+    }
+#endif
+
+    const StateStore& reachable = SharedStates(app, states, states_stats, complete);
+    size_t P = reachable.NumPlaces(), V = objectives.size();
+    results.assign(V, { {}, INT_MIN });
+
+    // Blocks of B vectors; coefficients transposed to place-major so the inner
+    // loops run over contiguous vector lanes
+    const size_t B = 64;
+    std::vector<int> coef(P * B), acc(B), best(B);
+    std::vector<uint32_t> arg(B);
+    for (size_t v0 = 0; v0 < V; v0 += B) {
+        size_t nb = std::min(B, V - v0);
+        std::fill(coef.begin(), coef.end(), 0);
+        for (size_t v = 0; v < nb; ++v) {
+            const auto& c = objectives[v0 + v];
+            for (size_t p = 0; p < P && p < c.size(); ++p) coef[p * B + v] = c[p];
+        }
+        std::fill(best.begin(), best.end(), INT_MIN);
+        std::fill(arg.begin(), arg.end(), 0);
+        for (uint32_t id = 0; id < reachable.size(); ++id) {
+            const int* m = reachable.Data(id);
+            std::fill(acc.begin(), acc.end(), 0);
+            for (size_t p = 0; p < P; ++p) {
+                int tokens = m[p];
+                if (tokens == 0) continue;
+                const int* row = &coef[p * B];
+                for (size_t v = 0; v < B; ++v) acc[v] += tokens * row[v];
+            }
+            for (size_t v = 0; v < B; ++v) {
+                bool better = acc[v] > best[v];
+                best[v] = better ? acc[v] : best[v];
+                arg[v] = better ? id : arg[v];
+            }
+        }
+        for (size_t v = 0; v < nb && reachable.size() > 0; ++v) {
+            results[v0 + v] = { reachable.Get(arg[v]), best[v] };
+        }
+    }
+    return results;
+}
+
+#ifndef NO_CUDD
+// Best-first enumeration of the paths of the BDD by decreasing value. A search
+// entry is a partial assignment of the places of rank < k, with the edge e
+// still to be satisfied; its bound acc + (best completion) is exact, so every
+// expanded entry leads to at least one result and results pop out in order.
+// Partial assignments share prefixes through a trail of (parent, place, bit)
+// steps, reference counted by queued entries and child steps; a step is
+// recycled once nothing uses it, so the trail stays proportional to the queue
+// instead of growing with every result.
+static void EnumerateDescending(const LongestPath& lp, long long min_value,
+                                size_t limit, const MarkingSink& sink) {
+    struct Entry { long long bound, acc; uint32_t e; int k; uint32_t trail; };
+    struct Step { uint32_t parent; int place; bool bit; uint32_t refs; };
+    struct Less { bool operator()(const Entry& a, const Entry& b) const { return a.bound < b.bound; } };
+    const uint32_t ROOT = UINT32_MAX;
+    const FlatBDD& g = lp.g;
+    int n = (int)g.order.size();
+
+    std::vector<Step> trail;
+    std::vector<uint32_t> free_steps;
+    std::priority_queue<Entry, std::vector<Entry>, Less> open;
+    long long best = lp.Bound(g.root, 0);
+    if (best != NEG_INF && best >= min_value) open.push({best, 0, g.root, 0, ROOT});
+
+    auto push = [&](uint32_t e, int k, long long acc, uint32_t parent, int place, bool bit) {
+        long long b = lp.Bound(e, k);
+        if (b == NEG_INF || acc + b < min_value) return;
+        uint32_t s = (uint32_t)trail.size();
+        if (free_steps.empty()) trail.push_back({parent, place, bit, 1});
+        else { s = free_steps.back(); free_steps.pop_back(); trail[s] = {parent, place, bit, 1}; }
+        if (parent != ROOT) trail[parent].refs++;
+        open.push({acc + b, acc, e, k, s});
+    };
+    // Drops one reference to step s, recycling it (and then its parent) at zero
+    auto release = [&](uint32_t s) {
+        while (s != ROOT && --trail[s].refs == 0) {
+            free_steps.push_back(s);
+            s = trail[s].parent;
         }
+    };
 
-        if (best_val != INT_MIN) {
-            return { best_marking, best_val };
+    size_t emitted = 0;
+    while (!open.empty() && emitted < limit) {
+        Entry top = open.top();
+        open.pop();
+        if (top.k == n) {
+            Marking m(n, 0);
+            for (uint32_t s = top.trail; s != ROOT; s = trail[s].parent) m[trail[s].place] = trail[s].bit;
+            release(top.trail);
+            ++emitted;
+            if (!sink(m, (int)top.acc)) break;
+            continue;
         }
-        // nếu chưa có, fallback xuống explicit
+        int place = g.order[top.k];
+        uint32_t t = top.e, f = top.e;
+        // The place at rank k is either tested by e or skipped (free)
+        if (g.Rank(top.e) == top.k) { t = g.Then(top.e); f = g.Else(top.e); }
+        push(t, top.k + 1, top.acc + lp.coef[top.k], top.trail, place, true);
+        push(f, top.k + 1, top.acc, top.trail, place, false);
+        release(top.trail);
     }
+}
 #endif
 
-    long long t_ms = 0;
-    std::set<Marking> reachable = app.ComputeExplicit(t_ms);
-    for (const auto& m : reachable) {
-        int val = dotProduct(m, objective_vector);
-        if (val > best_val) {
-            best_val = val;
-            best_marking = m;
+void MarkingOptimizerBB::topKReachable(DdNode* reachable_bdd,
+                                       const std::vector<int>& objective_vector,
+                                       size_t k,
+                                       PetriNetAnalysis& app,
+                                       const MarkingSink& sink,
+                                       StateStore& states,
+                                       RunStats& states_stats,
+                                       bool* complete)
+{
+    if (complete) *complete = true;
+    if (k == 0) return;
+#ifndef NO_CUDD
+    if (reachable_bdd) {
+        FlatBDD flat(app.bdd_mgr, reachable_bdd);
+        if (flat.ok) {
+            EnumerateDescending(LongestPath(flat, objective_vector), NEG_INF, k, sink);
+            return;
         }
     }
+#endif
 
-    if (best_val == INT_MIN) {
-        return { {}, INT_MIN };
+    // Min-heap of the k best (value, id) pairs seen so far
+    const StateStore& reachable = SharedStates(app, states, states_stats, complete);
+    std::priority_queue<std::pair<int, uint32_t>, std::vector<std::pair<int, uint32_t>>,
+                        std::greater<std::pair<int, uint32_t>>> heap;
+    for (uint32_t id = 0; id < reachable.size(); ++id) {
+        int val = dotProduct(reachable.Data(id), reachable.NumPlaces(), objective_vector);
+        if (heap.size() < k) heap.push({val, id});
+        else if (val > heap.top().first) { heap.pop(); heap.push({val, id}); }
+    }
+    std::vector<std::pair<int, uint32_t>> best;
+    for (; !heap.empty(); heap.pop()) best.push_back(heap.top());
+    for (auto it = best.rbegin(); it != best.rend(); ++it) {
+        if (!sink(reachable.Get(it->second), it->first)) break;
+    }
+}
+
+void MarkingOptimizerBB::thresholdReachable(DdNode* reachable_bdd,
+                                            const std::vector<int>& objective_vector,
+                                            int min_value,
+                                            PetriNetAnalysis& app,
+                                            const MarkingSink& sink,
+                                            StateStore& states,
+                                            RunStats& states_stats,
+                                            bool* complete)
+{
+    if (complete) *complete = true;
+#ifndef NO_CUDD
+    if (reachable_bdd) {
+        FlatBDD flat(app.bdd_mgr, reachable_bdd);
+        if (flat.ok) {
+            EnumerateDescending(LongestPath(flat, objective_vector), min_value, SIZE_MAX, sink);
+            return;
+        }
+    }
+#endif
+
+    const StateStore& reachable = SharedStates(app, states, states_stats, complete);
+    for (uint32_t id = 0; id < reachable.size(); ++id) {
+        int val = dotProduct(reachable.Data(id), reachable.NumPlaces(), objective_vector);
+        if (val >= min_value && !sink(reachable.Get(id), val)) break;
     }
-    return { best_marking, best_val };
 }
+
+#ifndef NO_CUDD
+// Distinct terminal values of an ADD
+static void CollectLeaves(DdNode* f, std::set<DdNode*>& seen, std::set<double>& leaves) {
+    f = Cudd_Regular(f);
+    if (!seen.insert(f).second) return;
+    if (Cudd_IsConstant(f)) { leaves.insert(Cudd_V(f)); return; }
+    CollectLeaves(Cudd_T(f), seen, leaves);
+    CollectLeaves(Cudd_E(f), seen, leaves);
+}
+#endif
+
+std::vector<std::pair<long long, double>>
+MarkingOptimizerBB::objectiveHistogram(DdNode* reachable_bdd,
+                                       const std::vector<int>& objective_vector,
+                                       PetriNetAnalysis& app,
+                                       StateStore& states,
+                                       RunStats& states_stats,
+                                       bool* complete)
+{
+    std::vector<std::pair<long long, double>> hist;
+    if (complete) *complete = true;
+#ifndef NO_CUDD
+    if (reachable_bdd) {
+        DdManager* dd = app.bdd_mgr.manager;
+        DdNode* obj = app.bdd_mgr.BuildObjectiveADD(objective_vector);
+        DdNode* reach = obj ? Cudd_BddToAdd(dd, reachable_bdd) : nullptr;
+        if (reach) Cudd_Ref(reach);
+        // Unreachable markings map to +inf, which is not a value of c·m
+        DdNode* f = reach ? Cudd_addIte(dd, reach, obj, Cudd_ReadPlusInfinity(dd)) : nullptr;
+        if (f) Cudd_Ref(f);
+
+        bool ok = f != nullptr;
+        if (f) {
+            std::set<DdNode*> seen;
+            std::set<double> leaves;
+            CollectLeaves(f, seen, leaves);
+            for (double v : leaves) {
+                if (v == Cudd_V(Cudd_ReadPlusInfinity(dd))) continue;
+                DdNode* b = Cudd_addBddInterval(dd, f, v, v);
+                if (!b) { ok = false; break; }
+                Cudd_Ref(b);
+                hist.push_back({std::llround(v), app.bdd_mgr.CountStates(b)});
+                Cudd_RecursiveDeref(dd, b);
+            }
+        }
+        if (obj) Cudd_RecursiveDeref(dd, obj);
+        if (reach) Cudd_RecursiveDeref(dd, reach);
+        if (f) Cudd_RecursiveDeref(dd, f);
+        if (ok) return hist;
+        hist.clear();
+    }
+#endif
+
+    const StateStore& reachable = SharedStates(app, states, states_stats, complete);
+    std::map<long long, double> counts;
+    for (uint32_t id = 0; id < reachable.size(); ++id) {
+        counts[dotProduct(reachable.Data(id), reachable.NumPlaces(), objective_vector)] += 1;
+    }
+    hist.assign(counts.begin(), counts.end());
+    return hist;
+}
+
+#ifdef USE_GLPK
+StateEquationResult
+MarkingOptimizerBB::maxByStateEquation(const std::vector<int>& objective_vector,
+                                       PetriNetAnalysis& app,
+                                       DdNode* reachable_bdd,
+                                       const std::vector<int>& place_bounds,
+                                       int max_rounds)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    int P = (int)app.places.size();
+
+    // m0 luôn reachable nên là lời giải ban đầu
+    StateEquationResult res = {app.initial_marking, 0, 0.0, false, false, 0, 0};
+    res.value = dotProduct(app.initial_marking.data(), P, objective_vector);
+    bool safe = (int)place_bounds.size() == P;
+    for (int b : place_bounds) if (b > 1) safe = false;
+
+    glp_prob* lp = BuildStateEquation(app, objective_vector, place_bounds);
+
+    // No presolve: each round starts the simplex from the previous optimal
+    // basis, and the MIP search starts from that LP optimum
+    glp_smcp smcp;
+    glp_init_smcp(&smcp);
+    smcp.msg_lev = GLP_MSG_OFF;
+    glp_iocp iocp;
+    glp_init_iocp(&iocp);
+    iocp.msg_lev = GLP_MSG_OFF;
+    iocp.presolve = GLP_OFF;
+
+    // All rounds share one deadline: each solve and reachability check only
+    // gets the time left
+    BudgetGuard guard(app.budget);
+    ResourceBudget left = app.budget;
+
+    while (res.rounds < max_rounds && guard.RemainingMs() > 0) {
+        res.rounds++;
+        if (app.budget.time_limit_ms) {
+            left.time_limit_ms = guard.RemainingMs();
+            smcp.tm_lim = iocp.tm_lim = (int)std::min<long long>(left.time_limit_ms, INT_MAX);
+        }
+        if (glp_simplex(lp, &smcp) != 0 || glp_get_status(lp) != GLP_OPT) break;
+        if (glp_intopt(lp, &iocp) != 0 || glp_mip_status(lp) != GLP_OPT) break;
+        res.upper_bound = glp_mip_obj_val(lp);
+        res.has_bound = true;
+
+        Marking cand(P);
+        for (int p = 0; p < P; ++p) cand[p] = (int)std::lround(glp_mip_col_val(lp, p + 1));
+        int cand_val = dotProduct(cand.data(), P, objective_vector);
+        if (cand_val <= res.value) { res.exact = true; break; }
+
+        // Reachable set BDD (even a partial one) proves reachability
+        int reach = app.bdd_mgr.Contains(reachable_bdd, cand) ? 1 : app.ReachesMarking(cand, nullptr, &left);
+        if (reach == 1) {
+            res.marking = cand;
+            res.value = cand_val;
+            res.exact = true;
+            break;
+        }
+        if (reach < 0 || !safe) break;
+
+        // Spurious 0/1 solution
+        PetriNetAnalysis::AddNoGoodCut(lp, cand);
+    }
+    glp_delete_prob(lp);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    res.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    return res;
+}
+#endif
@@ -2,15 +2,112 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <functional>
 #include "petri.h"
 
+// Nhận từng kết quả (marking, giá trị) ngay khi tìm được; trả về false để dừng sớm
+typedef std::function<bool(const std::vector<int>&, int)> MarkingSink;
+
+#ifdef USE_GLPK
+// Kết quả của engine ILP: `marking` reachable với giá trị `value`;
+// upper_bound chặn trên mọi marking reachable, exact khi hai giá trị trùng nhau.
+struct StateEquationResult {
+    std::vector<int> marking;
+    int value;
+    double upper_bound;
+    bool has_bound;      // false nếu ILP không giải được (unbounded, timeout)
+    bool exact;
+    int rounds;          // số lần giải ILP
+    long long time_ms;
+};
+#endif
+
 class MarkingOptimizerBB {
 public:
     //(marking tối ưu, giá trị max). Nếu không có, trả về ([], INT_MIN)
+    // Không có BDD: duyệt explicit ưu tiên marking có giá trị cao, dừng khi đạt
+    // cận trên (từ place_bounds và LP relaxation nếu có GLPK). place_bounds chỉ
+    // được lấy từ một lần coverability chạy hết; rỗng = không có cận theo place.
+    // *optimal = false khi ngân sách hết trước khi chứng minh được tối ưu.
     static std::pair<std::vector<int>, int> maxReachableMarking(
         const std::vector<std::string>& place_ids,
         DdNode* reachable_bdd,                    
         const std::vector<int>& objective_vector,
-        PetriNetAnalysis& app   
+        PetriNetAnalysis& app,
+        const std::vector<int>& place_bounds = std::vector<int>(),
+        bool* optimal = nullptr
+    );
+
+    // Như maxReachableMarking cho nhiều vector mục tiêu, tính tập reachable một
+    // lần. Trên BDD: sao chép BDD một lần thành mảng node, mỗi vector là một lượt
+    // quy hoạch động trên mảng. Không có BDD: một lượt quét tập explicit cho cả
+    // khối vector (vòng lặp trong theo vector, compiler vector hóa được);
+    // states, states_stats, complete như topKReachable.
+    static std::vector<std::pair<std::vector<int>, int>> maxReachableBatch(
+        DdNode* reachable_bdd,
+        const std::vector<std::vector<int>>& objectives,
+        PetriNetAnalysis& app,
+        StateStore& states,
+        RunStats& states_stats,
+        bool* complete = nullptr
+    );
+
+    // k marking có giá trị lớn nhất, theo thứ tự giảm dần. Trên BDD: duyệt
+    // best-first với cận chính xác từ quy hoạch động longest-path, chỉ đi vào
+    // các nhánh còn chứa kết quả. Không có BDD: quét tập explicit với heap k phần tử.
+    // Tập explicit là `states` (thường là của Task 2, mô tả bởi states_stats);
+    // nếu rỗng thì được duyệt tại đây và giữ lại cho các truy vấn sau.
+    // *complete = false khi kết quả chỉ tính trên phần đã duyệt trong ngân sách.
+    static void topKReachable(
+        DdNode* reachable_bdd,
+        const std::vector<int>& objective_vector,
+        size_t k,
+        PetriNetAnalysis& app,
+        const MarkingSink& sink,
+        StateStore& states,
+        RunStats& states_stats,
+        bool* complete = nullptr
+    );
+    // Mọi marking có giá trị >= min_value. Trên BDD theo thứ tự giảm dần,
+    // trên tập explicit theo thứ tự BFS. states, states_stats, complete như
+    // topKReachable.
+    static void thresholdReachable(
+        DdNode* reachable_bdd,
+        const std::vector<int>& objective_vector,
+        int min_value,
+        PetriNetAnalysis& app,
+        const MarkingSink& sink,
+        StateStore& states,
+        RunStats& states_stats,
+        bool* complete = nullptr
+    );
+
+    // Phân phối giá trị c·m trên tập reachable: các cặp (giá trị, số marking),
+    // tăng dần theo giá trị. Trên BDD: ADD ITE(reach, c·x, +inf), mỗi lá hữu hạn
+    // là một giá trị, số marking = CountMinterm(addBddInterval(v, v)); không liệt kê
+    // từng marking. Không có BDD: đếm trên tập explicit (states, states_stats,
+    // complete như topKReachable).
+    static std::vector<std::pair<long long, double>> objectiveHistogram(
+        DdNode* reachable_bdd,
+        const std::vector<int>& objective_vector,
+        PetriNetAnalysis& app,
+        StateStore& states,
+        RunStats& states_stats,
+        bool* complete = nullptr
+    );
+
+#ifdef USE_GLPK
+    // Max c·m trên phương trình trạng thái m = m0 + C·sigma, dùng khi không có
+    // BDD đầy đủ. Nghiệm được kiểm tra reachable (BDD rồi explicit); nghiệm giả
+    // bị loại bằng một lát cắt và ILP được giải lại trên cùng glp_prob.
+    // place_bounds (từ một lần coverability chạy hết, có thể rỗng) giới hạn m;
+    // lát cắt chỉ dùng được khi mọi place 1-bounded.
+    static StateEquationResult maxByStateEquation(
+        const std::vector<int>& objective_vector,
+        PetriNetAnalysis& app,
+        DdNode* reachable_bdd,
+        const std::vector<int>& place_bounds,
+        int max_rounds = 50
     );
+#endif
 };
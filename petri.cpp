@@ -1,5 +1,55 @@
 #include "petri.h"
 #include <climits> 
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <random>
+#include <atomic>
+#include <thread>
+#if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+#ifdef __linux__
+    #include <unistd.h>
+#endif
+
+// RESOURCE BUDGETS
+static size_t CurrentRssMb() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, resident = 0;
+    if (statm >> total >> resident) return resident * (size_t)sysconf(_SC_PAGESIZE) / (1024 * 1024);
+#endif
+    return 0;
+}
+
+BudgetGuard::BudgetGuard(const ResourceBudget& b, unsigned p)
+    : budget(b), start(std::chrono::steady_clock::now()), period(p), calls(0) {}
+
+bool BudgetGuard::Exceeded(double states, RunStats& stats) {
+    if (stats.aborted) return true;
+    if (budget.max_states && states > budget.max_states) {
+        stats.aborted = true; stats.reason = "state limit";
+        return true;
+    }
+    if (++calls < period) return false;
+    calls = 0;
+    if (budget.time_limit_ms) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (ms > budget.time_limit_ms) { stats.aborted = true; stats.reason = "time limit"; return true; }
+    }
+    if (budget.max_rss_mb && CurrentRssMb() > budget.max_rss_mb) {
+        stats.aborted = true; stats.reason = "RSS limit";
+        return true;
+    }
+    return false;
+}
+
+long long BudgetGuard::RemainingMs() const {
+    if (!budget.time_limit_ms) return LLONG_MAX;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    return budget.time_limit_ms - ms;
+}
 
 // BDD WRAPPER IMPLEMENTATION
 BDDWrapper::BDDWrapper() {
@@ -15,15 +65,156 @@ BDDWrapper::~BDDWrapper() {
 #endif
 }
 
-void BDDWrapper::Init(int num_places) {
 #ifndef NO_CUDD
-    x_vars.resize(num_places);
-    xp_vars.resize(num_places);
-    for (int i = 0; i < num_places; ++i) {
-        x_vars[i] = Cudd_bddNewVar(manager);
-        xp_vars[i] = Cudd_bddNewVar(manager);
+// acc &= f, releasing the old acc; acc becomes nullptr if a limit was hit
+static void AndInto(DdManager* dd, DdNode*& acc, DdNode* f) {
+    if (!acc) return;
+    DdNode* tmp = f ? Cudd_bddAnd(dd, acc, f) : nullptr;
+    if (tmp) Cudd_Ref(tmp);
+    Cudd_RecursiveDeref(dd, acc);
+    acc = tmp;
+}
+#endif
+
+void BDDWrapper::Init(int num_places, const std::vector<std::vector<int>>& place_blocks) {
+#ifndef NO_CUDD
+    // Cached conditions refer to the previous variables
+    for (DdNode* e : enabling) if (e) Cudd_RecursiveDeref(manager, e);
+    for (DdNode* e : marked) Cudd_RecursiveDeref(manager, e);
+    for (DdNode* e : marked_next) Cudd_RecursiveDeref(manager, e);
+    enabling.clear();
+    marked.clear();
+    marked_next.clear();
+
+    blocks = place_blocks;
+    place_block.assign(num_places, -1);
+    place_code.assign(num_places, 0);
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        std::sort(blocks[b].begin(), blocks[b].end());
+        for (size_t k = 0; k < blocks[b].size(); ++k) {
+            place_block[blocks[b][k]] = (int)b;
+            place_code[blocks[b][k]] = (int)k;
+        }
+    }
+
+    // Slots follow the place order; a block's bits sit where its first place is
+    x_vars.clear();
+    xp_vars.clear();
+    place_slot.assign(num_places, -1);
+    block_slots.assign(blocks.size(), std::vector<int>());
+    for (int p = 0; p < num_places; ++p) {
+        int b = place_block[p];
+        if (b >= 0 && place_code[p] != 0) continue;
+        size_t bits = 1;
+        if (b >= 0) for (bits = 0; ((size_t)1 << bits) < blocks[b].size(); ++bits) {}
+        for (size_t i = 0; i < bits; ++i) {
+            if (b >= 0) block_slots[b].push_back((int)x_vars.size());
+            else place_slot[p] = (int)x_vars.size();
+            x_vars.push_back(Cudd_bddNewVar(manager));
+            xp_vars.push_back(Cudd_bddNewVar(manager));
+        }
+    }
+    var_place.assign(Cudd_ReadSize(manager), -1);
+    var_slot.assign(Cudd_ReadSize(manager), -1);
+    for (size_t i = 0; i < x_vars.size(); ++i) var_slot[Cudd_NodeReadIndex(x_vars[i])] = (int)i;
+    for (int p = 0; p < num_places; ++p) {
+        if (place_slot[p] >= 0) var_place[Cudd_NodeReadIndex(x_vars[place_slot[p]])] = p;
+    }
+
+    // A plain place is marked iff its variable is set, a block place iff the
+    // bits hold its code
+    marked.resize(num_places);
+    marked_next.resize(num_places);
+    for (int p = 0; p < num_places; ++p) {
+        for (int next = 0; next < 2; ++next) {
+            const std::vector<DdNode*>& vars = next ? xp_vars : x_vars;
+            DdNode* lit;
+            if (place_slot[p] >= 0) {
+                lit = vars[place_slot[p]];
+            } else {
+                const std::vector<int>& slots = block_slots[place_block[p]];
+                std::vector<DdNode*> cube_vars;
+                std::vector<int> phase;
+                for (size_t i = 0; i < slots.size(); ++i) {
+                    cube_vars.push_back(vars[slots[i]]);
+                    phase.push_back(place_code[p] >> i & 1);
+                }
+                lit = Cudd_bddComputeCube(manager, cube_vars.data(), phase.data(), (int)slots.size());
+            }
+            Cudd_Ref(lit);
+            (next ? marked_next : marked)[p] = lit;
+        }
+    }
+#endif
+}
+
+bool BDDWrapper::Decode(const std::vector<char>& bits, Marking& m) const {
+    m.assign(place_slot.size(), 0);
+    for (size_t p = 0; p < place_slot.size(); ++p) {
+        if (place_slot[p] >= 0) m[p] = bits[place_slot[p]];
+    }
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        size_t code = 0;
+        for (size_t i = 0; i < block_slots[b].size(); ++i) code |= (size_t)bits[block_slots[b][i]] << i;
+        if (code >= blocks[b].size()) return false;
+        m[blocks[b][code]] = 1;
+    }
+    return true;
+}
+
+bool BDDWrapper::Encode(const Marking& m, std::vector<char>& bits) const {
+    bits.assign(x_vars.size(), 0);
+    for (size_t p = 0; p < place_slot.size(); ++p) {
+        if (m[p] > 1) return false;
+        if (place_slot[p] >= 0) bits[place_slot[p]] = (char)m[p];
+    }
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        int tokens = 0;
+        for (size_t k = 0; k < blocks[b].size(); ++k) {
+            if (!m[blocks[b][k]]) continue;
+            ++tokens;
+            for (size_t i = 0; i < block_slots[b].size(); ++i) bits[block_slots[b][i]] = (char)(k >> i & 1);
+        }
+        if (tokens != 1) return false;
+    }
+    return true;
+}
+
+int BDDWrapper::PlaceOfVar(unsigned int index) const {
+    return index < var_place.size() ? var_place[index] : -1;
+}
+
+int BDDWrapper::SlotOfVar(unsigned int index) const {
+    return index < var_slot.size() ? var_slot[index] : -1;
+}
+
+bool BDDWrapper::Contains(DdNode* set, const Marking& m) const {
+#ifndef NO_CUDD
+    std::vector<char> bits;
+    if (!set || m.size() != place_slot.size() || !Encode(m, bits)) return false;
+    DdNode* f = set;
+    while (!Cudd_IsConstant(Cudd_Regular(f))) {
+        DdNode* r = Cudd_Regular(f);
+        int s = SlotOfVar(Cudd_NodeReadIndex(r));
+        if (s < 0) return false;
+        DdNode* next = bits[s] ? Cudd_T(r) : Cudd_E(r);
+        f = Cudd_IsComplement(f) ? Cudd_Not(next) : next;
     }
+    return f == Cudd_ReadOne(manager);
+#else
+    return false;
+#endif
+}
+
+std::vector<int> BDDWrapper::PlacesByLevel() {
+    std::vector<int> order;
+    for (size_t p = 0; p < place_slot.size(); ++p) if (place_slot[p] >= 0) order.push_back((int)p);
+#ifndef NO_CUDD
+    std::vector<int> level(place_slot.size());
+    for (int p : order) level[p] = Cudd_ReadPerm(manager, Cudd_NodeReadIndex(x_vars[place_slot[p]]));
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return level[a] < level[b]; });
 #endif
+    return order;
 }
 
 DdNode* BDDWrapper::GetZero() {
@@ -38,9 +229,10 @@ DdNode* BDDWrapper::BuildMarkingBDD(const Marking& m) {
 #ifndef NO_CUDD
     DdNode* res = Cudd_ReadOne(manager); Cudd_Ref(res);
     for (size_t i = 0; i < m.size(); ++i) {
-        DdNode* var = x_vars[i];
-        DdNode* lit = (m[i] == 1) ? var : Cudd_Not(var);
-        DdNode* tmp = Cudd_bddAnd(manager, res, lit); Cudd_Ref(tmp);
+        DdNode* lit = (m[i] == 1) ? marked[i] : Cudd_Not(marked[i]);
+        DdNode* tmp = Cudd_bddAnd(manager, res, lit);
+        if (!tmp) { Cudd_RecursiveDeref(manager, res); return nullptr; }
+        Cudd_Ref(tmp);
         Cudd_RecursiveDeref(manager, res); res = tmp;
     }
     return res;
@@ -58,27 +250,52 @@ DdNode* BDDWrapper::BuildTransitionRelation(const std::vector<std::vector<int>>&
         DdNode* R_t = Cudd_ReadOne(manager); Cudd_Ref(R_t);
 
         // Pre-condition: Input places must have tokens
-        for (size_t p = 0; p < incidence.size(); ++p) {
-            if (input[p][t] > 0) {
-                DdNode* tmp = Cudd_bddAnd(manager, R_t, x_vars[p]); Cudd_Ref(tmp);
-                Cudd_RecursiveDeref(manager, R_t); R_t = tmp;
-            }
+        for (size_t p = 0; p < incidence.size() && R_t; ++p) {
+            if (input[p][t] > 0) AndInto(manager, R_t, marked[p]);
         }
 
         // Post-condition: Update next state variables x'
-        for (size_t p = 0; p < incidence.size(); ++p) {
+        for (size_t p = 0; p < incidence.size() && R_t; ++p) {
+            int v = place_slot[p];
+            if (v < 0) continue;
             DdNode* next_state;
-            if (incidence[p][t] == -1) next_state = Cudd_Not(xp_vars[p]);
-            else if (incidence[p][t] == 1) next_state = xp_vars[p];
-            else next_state = Cudd_bddXnor(manager, xp_vars[p], x_vars[p]); // Frame condition
+            if (incidence[p][t] == -1) next_state = Cudd_Not(xp_vars[v]);
+            else if (incidence[p][t] == 1) next_state = xp_vars[v];
+            else next_state = Cudd_bddXnor(manager, xp_vars[v], x_vars[v]); // Frame condition
+            if (!next_state) { Cudd_RecursiveDeref(manager, R_t); R_t = nullptr; break; }
+            Cudd_Ref(next_state);
+            AndInto(manager, R_t, next_state);
+            Cudd_RecursiveDeref(manager, next_state);
+        }
 
-            DdNode* tmp = Cudd_bddAnd(manager, R_t, next_state); Cudd_Ref(tmp);
-            Cudd_RecursiveDeref(manager, R_t); R_t = tmp;
+        // A block takes the code of the place that receives its token, or
+        // keeps its bits when t does not touch it
+        for (size_t b = 0; b < blocks.size() && R_t; ++b) {
+            int changed = 0, gains = 0;
+            DdNode* next_state = nullptr;
+            for (int p : blocks[b]) {
+                if (incidence[p][t] != 0) ++changed;
+                if (incidence[p][t] == 1) { ++gains; next_state = marked_next[p]; }
+            }
+            if (changed) {
+                AndInto(manager, R_t, gains == 1 ? next_state : Cudd_ReadLogicZero(manager));
+                continue;
+            }
+            for (int v : block_slots[b]) {
+                DdNode* same = R_t ? Cudd_bddXnor(manager, xp_vars[v], x_vars[v]) : nullptr;
+                if (!same) { Deref(R_t); R_t = nullptr; break; }
+                Cudd_Ref(same);
+                AndInto(manager, R_t, same);
+                Cudd_RecursiveDeref(manager, same);
+            }
         }
+        if (!R_t) { Cudd_RecursiveDeref(manager, R_total); return nullptr; }
 
-        DdNode* tmp_total = Cudd_bddOr(manager, R_total, R_t); Cudd_Ref(tmp_total);
+        DdNode* tmp_total = Cudd_bddOr(manager, R_total, R_t);
+        if (tmp_total) Cudd_Ref(tmp_total);
         Cudd_RecursiveDeref(manager, R_total); Cudd_RecursiveDeref(manager, R_t);
         R_total = tmp_total;
+        if (!R_total) return nullptr;
     }
     return R_total;
 #else
@@ -88,21 +305,28 @@ DdNode* BDDWrapper::BuildTransitionRelation(const std::vector<std::vector<int>>&
 
 DdNode* BDDWrapper::SymbolicImage(DdNode* current, DdNode* relation) {
 #ifndef NO_CUDD
-    DdNode* and_res = Cudd_bddAnd(manager, current, relation); Cudd_Ref(and_res);
+    DdNode* and_res = Cudd_bddAnd(manager, current, relation);
+    if (!and_res) return nullptr;
+    Cudd_Ref(and_res);
     
     // Abstract x variables
     DdNode* cube = Cudd_ReadOne(manager); Cudd_Ref(cube);
     for (auto v : x_vars) {
-        DdNode* tmp = Cudd_bddAnd(manager, cube, v); Cudd_Ref(tmp);
+        DdNode* tmp = Cudd_bddAnd(manager, cube, v);
+        if (!tmp) { Cudd_RecursiveDeref(manager, cube); Cudd_RecursiveDeref(manager, and_res); return nullptr; }
+        Cudd_Ref(tmp);
         Cudd_RecursiveDeref(manager, cube); cube = tmp;
     }
 
-    DdNode* exist_res = Cudd_bddExistAbstract(manager, and_res, cube); Cudd_Ref(exist_res);
+    DdNode* exist_res = Cudd_bddExistAbstract(manager, and_res, cube);
+    if (exist_res) Cudd_Ref(exist_res);
     Cudd_RecursiveDeref(manager, and_res); Cudd_RecursiveDeref(manager, cube);
+    if (!exist_res) return nullptr;
 
     // Swap x' to x for the next iteration
     DdNode* res = Cudd_bddSwapVariables(manager, exist_res, x_vars.data(), xp_vars.data(), x_vars.size());
-    Cudd_Ref(res); Cudd_RecursiveDeref(manager, exist_res);
+    if (res) Cudd_Ref(res);
+    Cudd_RecursiveDeref(manager, exist_res);
     return res;
 #else
     return nullptr;
@@ -117,9 +341,50 @@ double BDDWrapper::CountStates(DdNode* bdd) {
 #endif
 }
 
+size_t BDDWrapper::ForEachMarking(DdNode* set, size_t limit, const std::function<bool(const Marking&)>& sink) {
+    size_t emitted = 0;
+#ifndef NO_CUDD
+    if (!set || set == Cudd_ReadLogicZero(manager)) return 0;
+    Marking m;
+    std::vector<char> bits(x_vars.size(), 0);
+    std::vector<size_t> free_slots;
+    DdGen* gen;
+    int* cube;
+    CUDD_VALUE_TYPE value;
+    Cudd_ForeachCube(manager, set, gen, cube, value) {
+        // cube[] is indexed by variable: 0, 1 or 2 (don't care)
+        free_slots.clear();
+        for (size_t v = 0; v < x_vars.size(); ++v) {
+            int c = cube[Cudd_NodeReadIndex(x_vars[v])];
+            if (c == 2) free_slots.push_back(v);
+            bits[v] = c == 1 ? 1 : 0;
+        }
+        // Binary counter over the don't-care variables; codes past the end of
+        // a block stand for no marking
+        bool stop = false;
+        while (true) {
+            if (Decode(bits, m)) {
+                if (limit && emitted >= limit) { stop = true; break; }
+                ++emitted;
+                if (!sink(m)) { stop = true; break; }
+            }
+            size_t i = 0;
+            while (i < free_slots.size() && bits[free_slots[i]] == 1) bits[free_slots[i++]] = 0;
+            if (i == free_slots.size()) break;
+            bits[free_slots[i]] = 1;
+        }
+        if (stop) {
+            Cudd_GenFree(gen);
+            break;
+        }
+    }
+#endif
+    return emitted;
+}
+
 DdNode* BDDWrapper::BDD_Or(DdNode* a, DdNode* b) {
 #ifndef NO_CUDD
-    DdNode* r = Cudd_bddOr(manager, a, b); Cudd_Ref(r); return r;
+    DdNode* r = Cudd_bddOr(manager, a, b); if (r) Cudd_Ref(r); return r;
 #else
     return nullptr;
 #endif
@@ -128,7 +393,7 @@ DdNode* BDDWrapper::BDD_Or(DdNode* a, DdNode* b) {
 DdNode* BDDWrapper::BDD_Minus(DdNode* a, DdNode* b) {
 #ifndef NO_CUDD
     DdNode* not_b = Cudd_Not(b);
-    DdNode* r = Cudd_bddAnd(manager, a, not_b); Cudd_Ref(r); return r;
+    DdNode* r = Cudd_bddAnd(manager, a, not_b); if (r) Cudd_Ref(r); return r;
 #else
     return nullptr;
 #endif
@@ -146,6 +411,41 @@ void BDDWrapper::Deref(DdNode* n) {
 #endif
 }
 
+void BDDWrapper::ApplyBudget(const ResourceBudget& budget) {
+#ifndef NO_CUDD
+    saved_max_live = Cudd_ReadMaxLive(manager);
+    saved_max_memory = Cudd_ReadMaxMemory(manager);
+    if (budget.max_bdd_nodes) Cudd_SetMaxLive(manager, (unsigned int)std::min<size_t>(budget.max_bdd_nodes, UINT_MAX));
+    if (budget.max_bdd_memory_mb) Cudd_SetMaxMemory(manager, budget.max_bdd_memory_mb * 1024 * 1024);
+    if (budget.time_limit_ms) {
+        Cudd_ResetStartTime(manager);
+        Cudd_SetTimeLimit(manager, (unsigned long)budget.time_limit_ms);
+    }
+#endif
+}
+
+void BDDWrapper::ClearBudget() {
+#ifndef NO_CUDD
+    Cudd_SetMaxLive(manager, saved_max_live);
+    Cudd_SetMaxMemory(manager, saved_max_memory);
+    Cudd_UnsetTimeLimit(manager);
+    Cudd_ClearErrorCode(manager);
+#endif
+}
+
+std::string BDDWrapper::BudgetError() {
+#ifndef NO_CUDD
+    switch (Cudd_ReadErrorCode(manager)) {
+        case CUDD_TOO_MANY_NODES:   return "BDD node limit";
+        case CUDD_MAX_MEM_EXCEEDED: return "BDD memory limit";
+        case CUDD_TIMEOUT_EXPIRED:  return "time limit";
+        case CUDD_MEMORY_OUT:       return "out of memory";
+        default: break;
+    }
+#endif
+    return "BDD operation failed";
+}
+
 // PETRI NET LOGIC
 using namespace tinyxml2;
 bool PetriNetAnalysis::CheckArcs(XMLElement* root) {
@@ -317,6 +617,7 @@ bool PetriNetAnalysis::ParsePNML(const std::string& filename) {
     for(auto& p : places) initial_marking[p.index] = p.initial_marking;
 
     CollectArcs(root_node);
+    BuildSparseArcs();
     objective_vector.resize(place_ids.size(), 1);
 
     return true;
@@ -326,243 +627,1904 @@ void PetriNetAnalysis::PrintInfo() const {
     std::cout << "Parsed: " << places.size() << " places, " << transitions.size() << " transitions.\n";
 }
 
-bool PetriNetAnalysis::IsEnabled(const Marking& m, int t) const {
-    for(size_t p=0; p<places.size(); ++p) if(input_matrix[p][t] > m[p]) return false;
+void PetriNetAnalysis::BuildSparseArcs() {
+    size_t nt = transitions.size();
+    pre_places.assign(nt, {});
+    post_places.assign(nt, {});
+    delta_places.assign(nt, {});
+    for (size_t t = 0; t < nt; ++t) {
+        for (size_t p = 0; p < places.size(); ++p) {
+            if (input_matrix[p][t] > 0) pre_places[t].push_back(p);
+            if (incidence_matrix[p][t] + input_matrix[p][t] > 0) post_places[t].push_back(p);
+            if (incidence_matrix[p][t] != 0) delta_places[t].push_back({(int)p, incidence_matrix[p][t]});
+        }
+    }
+
+    consumers.assign(places.size(), {});
+    producers.assign(places.size(), {});
+    for (size_t t = 0; t < nt; ++t) {
+        for (int p : pre_places[t]) consumers[p].push_back(t);
+        for (int p : post_places[t]) producers[p].push_back(t);
+    }
+
+    affected.assign(nt, {});
+    std::vector<size_t> mark(nt, nt);
+    for (size_t t = 0; t < nt; ++t) {
+        for (const auto& d : delta_places[t]) {
+            for (int u : consumers[d.first]) {
+                if (mark[u] != t) { mark[u] = t; affected[t].push_back(u); }
+            }
+        }
+    }
+
+    size_t W = EnabledWords();
+    disabled_by.assign(places.size() * W, 0);
+    all_transitions.assign(W, 0);
+    for (size_t t = 0; t < nt; ++t) {
+        all_transitions[t >> 6] |= 1ULL << (t & 63);
+        for (int p : pre_places[t]) disabled_by[p * W + (t >> 6)] |= 1ULL << (t & 63);
+    }
+
+    // Re-checking affected[t] costs one IsEnabled per transition; the bitset kernel
+    // costs a scan of the marking plus a few words per empty place.
+    full_update.assign(nt, 0);
+    for (size_t t = 0; t < nt; ++t) {
+        size_t incremental = 0;
+        for (int u : affected[t]) incremental += pre_places[u].size() + 1;
+        full_update[t] = incremental > places.size() + places.size() * W / 8;
+    }
+}
+
+bool PetriNetAnalysis::IsEnabled(const int* m, int t) const {
+    for (int p : pre_places[t]) if (input_matrix[p][t] > m[p]) return false;
     return true;
 }
 
 Marking PetriNetAnalysis::Fire(const Marking& m, int t) const {
     Marking n = m;
-    for(size_t p=0; p<places.size(); ++p) n[p] += incidence_matrix[p][t];
+    for (const auto& d : delta_places[t]) n[d.first] += d.second;
     return n;
 }
 
-std::set<Marking> PetriNetAnalysis::ComputeExplicit(long long& time) const {
-    auto start = std::chrono::high_resolution_clock::now();
-    std::set<Marking> visited; std::queue<Marking> q;
-    visited.insert(initial_marking); q.push(initial_marking);
-    
-    while(!q.empty()){
-        Marking u = q.front(); q.pop();
-        for(size_t t=0; t<transitions.size(); ++t){
-            if(IsEnabled(u, t)){
-                Marking v = Fire(u, t);
-                if(visited.find(v) == visited.end()){ visited.insert(v); q.push(v); }
-            }
-        }
+// dst |= src over n words
+static inline void OrWords(uint64_t* dst, const uint64_t* src, size_t n) {
+    size_t w = 0;
+#if defined(__AVX2__)
+    for (; w + 4 <= n; w += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + w));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + w));
+        _mm256_storeu_si256((__m256i*)(dst + w), _mm256_or_si256(a, b));
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    return visited;
+#elif defined(__SSE2__)
+    for (; w + 2 <= n; w += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + w));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + w));
+        _mm_storeu_si128((__m128i*)(dst + w), _mm_or_si128(a, b));
+    }
+#endif
+    for (; w < n; ++w) dst[w] |= src[w];
 }
 
-DdNode* PetriNetAnalysis::ComputeSymbolic(long long& time) {
-#ifndef NO_CUDD
+// dst = mask & ~dst over n words
+static inline void AndNotWords(uint64_t* dst, const uint64_t* mask, size_t n) {
+    size_t w = 0;
+#if defined(__AVX2__)
+    for (; w + 4 <= n; w += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + w));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(mask + w));
+        _mm256_storeu_si256((__m256i*)(dst + w), _mm256_andnot_si256(a, b));
+    }
+#elif defined(__SSE2__)
+    for (; w + 2 <= n; w += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + w));
+        __m128i b = _mm_loadu_si128((const __m128i*)(mask + w));
+        _mm_storeu_si128((__m128i*)(dst + w), _mm_andnot_si128(a, b));
+    }
+#endif
+    for (; w < n; ++w) dst[w] = mask[w] & ~dst[w];
+}
+
+// All input arcs have weight 1 (see CollectArcs), so a transition is disabled
+// exactly when one of its input places is empty: OR the consumer sets of the
+// empty places and invert.
+void PetriNetAnalysis::ComputeEnabledSet(const int* m, uint64_t* bits) const {
+    size_t W = EnabledWords();
+    std::fill(bits, bits + W, 0);
+    for (size_t p = 0; p < places.size(); ++p) {
+        if (m[p] == 0) OrWords(bits, disabled_by.data() + p * W, W);
+    }
+    AndNotWords(bits, all_transitions.data(), W);
+}
+
+void PetriNetAnalysis::UpdateEnabledSet(const int* m, int t, uint64_t* bits) const {
+    if (full_update[t]) { ComputeEnabledSet(m, bits); return; }
+    for (int u : affected[t]) {
+        if (IsEnabled(m, u)) bits[u >> 6] |= 1ULL << (u & 63);
+        else bits[u >> 6] &= ~(1ULL << (u & 63));
+    }
+}
+
+// Key for "place p holds v tokens". Keys are derived with splitmix64 instead of
+// a pre-generated table so that token counts are not bounded in advance.
+static uint64_t ZobristKey(int p, int v) {
+    uint64_t z = ((uint64_t)(uint32_t)p << 32 | (uint32_t)v) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t PetriNetAnalysis::HashMarking(const Marking& m) const {
+    uint64_t h = 0;
+    for (size_t p = 0; p < m.size(); ++p) h ^= ZobristKey(p, m[p]);
+    return h;
+}
+
+uint64_t PetriNetAnalysis::FireHash(const int* m, uint64_t h, int t) const {
+    for (const auto& d : delta_places[t]) {
+        h ^= ZobristKey(d.first, m[d.first]) ^ ZobristKey(d.first, m[d.first] + d.second);
+    }
+    return h;
+}
+
+// STATE STORE
+const uint32_t StateStore::NONE;
+
+StateStore::StateStore(size_t n) : num_places(n), table(1024, NONE) {}
+
+// True if cand == parent changed by delta, without building the successor
+static bool IsSuccessor(const int* cand, const int* parent, size_t n,
+                        const std::vector<std::pair<int, int>>& delta) {
+    for (const auto& d : delta) if (cand[d.first] != parent[d.first] + d.second) return false;
+    size_t changed = 0;
+    for (size_t p = 0; p < n; ++p) if (cand[p] != parent[p]) ++changed;
+    return changed == delta.size();
+}
+
+uint32_t StateStore::FindSuccessor(uint64_t h, uint32_t parent, const std::vector<std::pair<int, int>>& delta) const {
+    size_t mask = table.size() - 1;
+    for (size_t slot = h & mask; table[slot] != NONE; slot = (slot + 1) & mask) {
+        uint32_t id = table[slot];
+        if (hashes[id] == h && IsSuccessor(Data(id), Data(parent), num_places, delta)) return id;
+    }
+    return NONE;
+}
+
+uint32_t StateStore::Find(const Marking& m, uint64_t h) const {
+    size_t mask = table.size() - 1;
+    for (size_t slot = h & mask; table[slot] != NONE; slot = (slot + 1) & mask) {
+        uint32_t id = table[slot];
+        if (hashes[id] == h && std::equal(m.begin(), m.end(), Data(id))) return id;
+    }
+    return NONE;
+}
+
+uint32_t StateStore::Insert(const int* m, uint64_t h) {
+    if (2 * (size() + 1) > table.size()) Grow();
+    uint32_t id = size();
+    tokens.insert(tokens.end(), m, m + num_places);
+    hashes.push_back(h);
+    size_t mask = table.size() - 1;
+    size_t slot = h & mask;
+    while (table[slot] != NONE) slot = (slot + 1) & mask;
+    table[slot] = id;
+    return id;
+}
+
+uint32_t StateStore::InsertSuccessor(uint64_t h, uint32_t parent, const std::vector<std::pair<int, int>>& delta) {
+    if (2 * (size() + 1) > table.size()) Grow();
+    uint32_t id = size();
+    // Resize before taking the row pointer: the parent row may move
+    tokens.resize(tokens.size() + num_places);
+    int* row = tokens.data() + (size_t)id * num_places;
+    std::copy(Data(parent), Data(parent) + num_places, row);
+    for (const auto& d : delta) row[d.first] += d.second;
+    hashes.push_back(h);
+    size_t mask = table.size() - 1;
+    size_t slot = h & mask;
+    while (table[slot] != NONE) slot = (slot + 1) & mask;
+    table[slot] = id;
+    return id;
+}
+
+void StateStore::Grow() {
+    table.assign(table.size() * 2, NONE);
+    size_t mask = table.size() - 1;
+    for (uint32_t id = 0; id < size(); ++id) {
+        size_t slot = hashes[id] & mask;
+        while (table[slot] != NONE) slot = (slot + 1) & mask;
+        table[slot] = id;
+    }
+}
+
+StateStore PetriNetAnalysis::ComputeExplicit(long long& time, ReachabilityGraph* graph,
+                                             RunStats* stats, std::vector<uint64_t>* fired) const {
     auto start = std::chrono::high_resolution_clock::now();
-    bdd_mgr.Init(places.size());
-    
-    DdNode* M_reach = bdd_mgr.BuildMarkingBDD(initial_marking); bdd_mgr.Ref(M_reach);
-    DdNode* M_new = M_reach; bdd_mgr.Ref(M_new);
-    DdNode* R = bdd_mgr.BuildTransitionRelation(incidence_matrix, input_matrix); bdd_mgr.Ref(R);
-    
-    // Fixpoint Iteration
-    while (M_new != bdd_mgr.GetZero()) { 
-        DdNode* M_next = bdd_mgr.SymbolicImage(M_new, R);
-        DdNode* diff = bdd_mgr.BDD_Minus(M_next, M_reach);
-        
-        if (diff == bdd_mgr.GetZero()) {
-             bdd_mgr.Deref(diff); bdd_mgr.Deref(M_next); break; 
-        }
+    RunStats st = RunStats();
+    BudgetGuard guard(budget);
+    StateStore store(places.size());
 
-        bdd_mgr.Deref(M_new); M_new = diff;
-        DdNode* u = bdd_mgr.BDD_Or(M_reach, M_new);
-        bdd_mgr.Deref(M_reach); M_reach = u;
-        bdd_mgr.Deref(M_next);
+    // One BFS level at a time: the frontier holds state ids, and the enabled
+    // set of frontier[i] is bits[i * W .. i * W + W)
+    size_t W = EnabledWords();
+    std::vector<uint32_t> frontier, next_frontier;
+    std::vector<uint64_t> bits(W), next_bits;
+
+    frontier.push_back(store.Insert(initial_marking.data(), HashMarking(initial_marking)));
+    ComputeEnabledSet(initial_marking.data(), bits.data());
+    if (graph) { graph->offsets.assign(1, 0); graph->targets.clear(); graph->labels.clear(); }
+    if (fired) fired->assign(W, 0);
+
+    size_t i = 0;
+    for (; !frontier.empty(); st.depth++) {
+        for (i = 0; i < frontier.size(); ++i) {
+            if (guard.Exceeded(store.size(), st)) break;
+            uint32_t u = frontier[i];
+            const uint64_t* cur = bits.data() + i * W;
+            if (fired) for (size_t w = 0; w < W; ++w) (*fired)[w] |= cur[w];
+
+            for (size_t w = 0; w < W && !st.aborted; ++w) {
+                for (uint64_t word = cur[w]; word; word &= word - 1) {
+                    int t = (int)(w * 64 + __builtin_ctzll(word));
+                    uint64_t h = FireHash(store.Data(u), store.Hash(u), t);
+                    uint32_t v = store.FindSuccessor(h, u, delta_places[t]);
+                    if (v == StateStore::NONE) {
+                        if (store.size() == StateStore::NONE - 1) {
+                            st.aborted = true; st.reason = "state id limit";
+                            break;
+                        }
+                        v = store.InsertSuccessor(h, u, delta_places[t]);
+                        next_frontier.push_back(v);
+                        size_t off = next_bits.size();
+                        next_bits.insert(next_bits.end(), cur, cur + W);
+                        UpdateEnabledSet(store.Data(v), t, &next_bits[off]);
+                    }
+                    if (graph) { graph->targets.push_back(v); graph->labels.push_back(t); }
+                }
+            }
+            if (st.aborted) break;
+            if (graph) graph->offsets.push_back(graph->targets.size());
+        }
+        if (st.aborted) break;
+        frontier.swap(next_frontier); next_frontier.clear();
+        bits.swap(next_bits); next_bits.clear();
     }
-    
+    if (graph) {
+        // On abort, drop the edges of a partly expanded state and give every
+        // state reached but not expanded an empty row after graph->expanded
+        graph->targets.resize(graph->offsets.back());
+        graph->labels.resize(graph->offsets.back());
+        graph->expanded = graph->offsets.size() - 1;
+        graph->offsets.resize(store.size() + 1, graph->offsets.back());
+    }
+    st.states = store.size();
+    st.frontier = frontier.empty() ? 0 : frontier.size() - i + next_frontier.size();
+    if (stats) *stats = st;
     auto end = std::chrono::high_resolution_clock::now();
     time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    return M_reach;
-#else
-    std::cout << "[WARN] CUDD not found. Skipping Task 3.\n";
-    time = 0;
-    return nullptr;
-#endif
+    return store;
 }
 
-DdNode* BDDWrapper::BuildDeadlockMask(const std::vector<std::vector<int>>& input_matrix) {
-#ifndef NO_CUDD
-    DdNode* all_dead = Cudd_ReadOne(manager); 
-    Cudd_Ref(all_dead);
-    
-    size_t num_places = input_matrix.size();
-    if (num_places == 0) return all_dead; 
-    size_t num_trans = input_matrix[0].size();
+// Store ids are handed out in BFS order, so the store itself is the queue
+int PetriNetAnalysis::ReachesMarking(const Marking& target, RunStats* stats,
+                                     const ResourceBudget* limits) const {
+    RunStats st = RunStats();
+    BudgetGuard guard(limits ? *limits : budget);
+    StateStore store(places.size());
+    uint64_t target_hash = HashMarking(target);
+    std::vector<uint64_t> bits(EnabledWords());
 
-    for (size_t t = 0; t < num_trans; ++t) {
-        bool has_input = false;
-        for (size_t p = 0; p < num_places; ++p) {
-            if (input_matrix[p][t] > 0) {
-                has_input = true;
-                break;
+    store.Insert(initial_marking.data(), HashMarking(initial_marking));
+    bool found = initial_marking == target;
+    for (uint32_t u = 0; u < store.size() && !found; ++u) {
+        if (guard.Exceeded(store.size(), st)) break;
+        ComputeEnabledSet(store.Data(u), bits.data());
+        for (size_t w = 0; w < bits.size() && !found; ++w) {
+            for (uint64_t word = bits[w]; word; word &= word - 1) {
+                int t = (int)(w * 64 + __builtin_ctzll(word));
+                uint64_t h = FireHash(store.Data(u), store.Hash(u), t);
+                if (store.FindSuccessor(h, u, delta_places[t]) != StateStore::NONE) continue;
+                if (store.size() == StateStore::NONE - 1) {
+                    st.aborted = true; st.reason = "state id limit";
+                    break;
+                }
+                uint32_t v = store.InsertSuccessor(h, u, delta_places[t]);
+                if (h == target_hash && std::equal(target.begin(), target.end(), store.Data(v))) {
+                    found = true;
+                    break;
+                }
             }
+            if (st.aborted) break;
         }
-        
-        if (!has_input) {
-            Cudd_RecursiveDeref(manager, all_dead);
-            return Cudd_ReadLogicZero(manager);
-        }
-        
-        DdNode* t_enabled = Cudd_ReadOne(manager); 
-        Cudd_Ref(t_enabled);
-        
-        for (size_t p = 0; p < num_places; ++p) {
-            if (input_matrix[p][t] > 0) {
-                DdNode* tmp = Cudd_bddAnd(manager, t_enabled, x_vars[p]); 
-                Cudd_Ref(tmp);
-                Cudd_RecursiveDeref(manager, t_enabled);
-                t_enabled = tmp;
-            }
-        }
-        DdNode* t_disabled = Cudd_Not(t_enabled);
-        DdNode* tmp_dead = Cudd_bddAnd(manager, all_dead, t_disabled); 
-        Cudd_Ref(tmp_dead);
-        
-        Cudd_RecursiveDeref(manager, all_dead);
-        Cudd_RecursiveDeref(manager, t_enabled); 
-        
-        all_dead = tmp_dead;
+        if (st.aborted) break;
     }
-    
-    return all_dead;
-#else
-    return nullptr;
-#endif
+    st.states = store.size();
+    if (stats) *stats = st;
+    if (found) return 1;
+    return st.aborted ? -1 : 0;
 }
 
-Marking BDDWrapper::PickOneMarking(DdNode* bdd) {
-    Marking m(x_vars.size(), 0);
-#ifndef NO_CUDD
-    if (bdd == Cudd_ReadLogicZero(manager)) return m; 
+Marking PetriNetAnalysis::ExploreMax(const std::vector<int>& c, long long upper_bound,
+                                     long long& best_value, bool& optimal, RunStats* stats) const {
+    RunStats st = RunStats();
+    BudgetGuard guard(budget);
+    StateStore store(places.size());
+    std::vector<uint64_t> bits(EnabledWords());
+    auto value = [&](const int* m) {
+        long long v = 0;
+        for (size_t p = 0; p < places.size() && p < c.size(); ++p) v += (long long)c[p] * m[p];
+        return v;
+    };
 
-    DdNode* current = bdd;
-    Cudd_Ref(current); 
-
-    for (size_t i = 0; i < x_vars.size(); ++i) {
-        DdNode* var = x_vars[i];
-        
-        DdNode* try_one = Cudd_bddAnd(manager, current, var); 
-        Cudd_Ref(try_one);
-        
-        if (try_one != Cudd_ReadLogicZero(manager)) {
-            m[i] = 1;
-            Cudd_RecursiveDeref(manager, current);
-            current = try_one;
-        } else {
-            Cudd_RecursiveDeref(manager, try_one);
-            m[i] = 0;
-            
-            DdNode* try_zero = Cudd_bddAnd(manager, current, Cudd_Not(var)); 
-            Cudd_Ref(try_zero);
-            
-            Cudd_RecursiveDeref(manager, current);
-            current = try_zero;
+    std::priority_queue<std::pair<long long, uint32_t>> open;
+    uint32_t best = store.Insert(initial_marking.data(), HashMarking(initial_marking));
+    best_value = value(initial_marking.data());
+    open.push({best_value, best});
+    while (!open.empty() && best_value < upper_bound) {
+        if (guard.Exceeded(store.size(), st)) break;
+        uint32_t u = open.top().second;
+        open.pop();
+        ComputeEnabledSet(store.Data(u), bits.data());
+        for (size_t w = 0; w < bits.size(); ++w) {
+            for (uint64_t word = bits[w]; word; word &= word - 1) {
+                int t = (int)(w * 64 + __builtin_ctzll(word));
+                uint64_t h = FireHash(store.Data(u), store.Hash(u), t);
+                if (store.FindSuccessor(h, u, delta_places[t]) != StateStore::NONE) continue;
+                if (store.size() == StateStore::NONE - 1) {
+                    st.aborted = true; st.reason = "state id limit";
+                    break;
+                }
+                uint32_t v = store.InsertSuccessor(h, u, delta_places[t]);
+                long long val = value(store.Data(v));
+                if (val > best_value) { best_value = val; best = v; }
+                open.push({val, v});
+            }
+            if (st.aborted) break;
         }
+        if (st.aborted) break;
     }
-    Cudd_RecursiveDeref(manager, current);
-#endif
-    return m;
+    optimal = best_value >= upper_bound || !st.aborted;
+    st.states = store.size();
+    st.frontier = open.size();
+    if (stats) *stats = st;
+    return store.Get(best);
 }
 
-#ifdef USE_GLPK
-bool PetriNetAnalysis::IsDeadlockByILP(const Marking& m) {
-    glp_prob *lp = glp_create_prob();
-    glp_set_prob_name(lp, "Deadlock_Verification");
-    
-    glp_set_obj_dir(lp, GLP_MAX); 
-    
-    glp_term_out(GLP_OFF);
-    
-    int T = transitions.size();
-    if (T == 0) {
-        glp_delete_prob(lp);
-        return true; 
+// COMPONENTS
+std::vector<NetComponent> PetriNetAnalysis::FindComponents() const {
+    size_t np = places.size(), nt = transitions.size();
+    // Places are elements 0..np-1, transitions np..np+nt-1
+    std::vector<int> parent(np + nt);
+    for (size_t e = 0; e < parent.size(); ++e) parent[e] = (int)e;
+    auto find = [&](int e) {
+        while (parent[e] != e) e = parent[e] = parent[parent[e]];
+        return e;
+    };
+    auto unite = [&](int a, int b) {
+        a = find(a); b = find(b);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    };
+    for (size_t t = 0; t < nt; ++t) {
+        for (int p : pre_places[t]) unite(p, (int)(np + t));
+        for (int p : post_places[t]) unite(p, (int)(np + t));
     }
-    
-    glp_add_cols(lp, T);
-    for (int t = 0; t < T; ++t) {
-        glp_set_col_kind(lp, t + 1, GLP_BV); 
-        glp_set_obj_coef(lp, t + 1, 1.0);    
+
+    std::vector<NetComponent> out;
+    std::vector<int> id(np + nt, -1);
+    for (size_t e = 0; e < np + nt; ++e) {
+        int r = find((int)e);
+        if (id[r] < 0) { id[r] = (int)out.size(); out.emplace_back(); }
+        if (e < np) out[id[r]].places.push_back((int)e);
+        else out[id[r]].transitions.push_back((int)(e - np));
     }
+    return out;
+}
 
-    int constraint_count = 0;
-    for (int t = 0; t < T; ++t) {
-        for (size_t p = 0; p < places.size(); ++p) {
-            if (input_matrix[p][t] > 0 && m[p] == 0) {
-                
-                constraint_count++;
-                glp_add_rows(lp, 1);
-                
-                int ind[2] = {0, t + 1};     
-                double val[2] = {0.0, 1.0};  
-                glp_set_mat_row(lp, constraint_count, 1, ind, val);
-                
-                glp_set_row_bnds(lp, constraint_count, GLP_FX, 0.0, 0.0);
-                
-                break; 
+void PetriNetAnalysis::ForEachComponent(const std::vector<NetComponent>& components, unsigned threads,
+                                        const std::function<void(size_t, const PetriNetAnalysis&)>& job) const {
+    size_t n = components.size();
+    // Largest components are handed out first, so the tail is made of small ones
+    std::vector<size_t> order(n);
+    for (size_t k = 0; k < n; ++k) order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return components[a].places.size() + components[a].transitions.size() >
+               components[b].places.size() + components[b].transitions.size();
+    });
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        // One subnet per worker, refilled for each component: a PetriNetAnalysis
+        // owns a CUDD manager, which is far too costly to set up per component
+        PetriNetAnalysis sub;
+        sub.budget = budget;
+        for (size_t k; (k = next++) < n;) {
+            const NetComponent& comp = components[order[k]];
+            size_t cp = comp.places.size(), ct = comp.transitions.size();
+            sub.places.clear();
+            sub.transitions.clear();
+            sub.place_ids.clear();
+            sub.incidence_matrix.assign(cp, std::vector<int>(ct, 0));
+            sub.input_matrix.assign(cp, std::vector<int>(ct, 0));
+            sub.initial_marking.assign(cp, 0);
+            for (size_t i = 0; i < cp; ++i) {
+                int p = comp.places[i];
+                sub.places.push_back(places[p]);
+                sub.places.back().index = (int)i;
+                sub.place_ids.push_back(place_ids[p]);
+                sub.initial_marking[i] = initial_marking[p];
+                for (size_t j = 0; j < ct; ++j) {
+                    sub.incidence_matrix[i][j] = incidence_matrix[p][comp.transitions[j]];
+                    sub.input_matrix[i][j] = input_matrix[p][comp.transitions[j]];
+                }
+            }
+            for (size_t j = 0; j < ct; ++j) {
+                sub.transitions.push_back(transitions[comp.transitions[j]]);
+                sub.transitions.back().index = (int)j;
             }
+            sub.BuildSparseArcs();
+            job(order[k], sub);
         }
-    }
-    
-    glp_iocp parm;
-    glp_init_iocp(&parm);
-    parm.msg_lev = GLP_MSG_OFF; 
-    parm.presolve = GLP_ON;     
-    
-    int status = glp_intopt(lp, &parm);
-    
-    bool is_deadlock = true; 
-    
-    if (status == 0) { 
-        double max_enabled = glp_mip_obj_val(lp);
-        
-        if (max_enabled > 0.5) {
-            is_deadlock = false;
+    };
+    unsigned workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = (unsigned)std::min<size_t>(workers, n);
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < workers; ++w) pool.emplace_back(worker);
+    worker();
+    for (std::thread& th : pool) th.join();
+}
+
+ComponentResult PetriNetAnalysis::AnalyzeComponents(const std::vector<NetComponent>& components,
+                                                    const std::vector<int>& c, unsigned threads) const {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t n = components.size();
+    struct Part {
+        RunStats stats = RunStats();
+        double states = 0, deadlocks = 0;
+        Marking dead, best;
+        long long best_value = LLONG_MIN;
+        std::vector<uint64_t> fired;
+    };
+    std::vector<Part> parts(n);
+    ForEachComponent(components, threads, [&](size_t k, const PetriNetAnalysis& sub) {
+        const NetComponent& comp = components[k];
+        Part& part = parts[k];
+        long long ms = 0;
+        StateStore store = sub.ComputeExplicit(ms, nullptr, &part.stats, &part.fired);
+        part.states = store.size();
+        std::vector<uint64_t> bits(sub.EnabledWords());
+        for (uint32_t id = 0; id < store.size(); ++id) {
+            const int* m = store.Data(id);
+            sub.ComputeEnabledSet(m, bits.data());
+            if (std::find_if(bits.begin(), bits.end(), [](uint64_t w) { return w != 0; }) == bits.end()) {
+                if (part.deadlocks++ == 0) part.dead = store.Get(id);
+            }
+            long long v = 0;
+            for (size_t i = 0; i < comp.places.size(); ++i) {
+                if ((size_t)comp.places[i] < c.size()) v += (long long)c[comp.places[i]] * m[i];
+            }
+            if (v > part.best_value) { part.best_value = v; part.best = store.Get(id); }
+        }
+    });
+
+    ComponentResult res = ComponentResult();
+    res.total_states = 1;
+    res.deadlock = true;
+    res.deadlocks = 1;
+    res.deadlock_marking.assign(places.size(), 0);
+    res.optimum_marking.assign(places.size(), 0);
+    res.fired.assign(EnabledWords(), 0);
+    for (size_t k = 0; k < n; ++k) {
+        const NetComponent& comp = components[k];
+        const Part& part = parts[k];
+        res.states.push_back(part.states);
+        res.total_states *= part.states;
+        if (part.stats.aborted && !res.stats.aborted) {
+            res.stats.aborted = true;
+            res.stats.reason = part.stats.reason;
+        }
+        res.stats.frontier += part.stats.frontier;
+        res.stats.depth = std::max(res.stats.depth, part.stats.depth);
+        if (part.deadlocks > 0) {
+            res.deadlocks *= part.deadlocks;
+            for (size_t i = 0; i < comp.places.size(); ++i) res.deadlock_marking[comp.places[i]] = part.dead[i];
+        } else {
+            res.deadlock = false;
+            if (!part.stats.aborted) res.deadlock_free = true;
+        }
+        res.optimum += part.best_value;
+        for (size_t i = 0; i < comp.places.size(); ++i) res.optimum_marking[comp.places[i]] = part.best[i];
+        for (size_t j = 0; j < comp.transitions.size(); ++j) {
+            if (part.fired[j / 64] >> (j % 64) & 1) {
+                int t = comp.transitions[j];
+                res.fired[t / 64] |= 1ULL << (t % 64);
+            }
         }
     }
-    
-    glp_delete_prob(lp);
-    
-    return is_deadlock;
+    res.stats.states = res.total_states;
+    if (!res.deadlock) { res.deadlocks = 0; res.deadlock_marking.clear(); }
+    auto end = std::chrono::high_resolution_clock::now();
+    res.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    return res;
 }
-#endif
 
-PetriNetAnalysis::DeadlockResult PetriNetAnalysis::DetectDeadlock(DdNode* reachable_bdd) {
+// Components do not interact, so a place is bounded by its own component
+CoverabilityResult PetriNetAnalysis::ComputeCoverability(const std::vector<NetComponent>& components,
+                                                         unsigned threads) const {
     auto start = std::chrono::high_resolution_clock::now();
-    DeadlockResult result = {false, {}, 0};
-    
-#ifndef NO_CUDD
-    std::cout << "[Task 4] Using BDD to generate deadlock candidates ...\n";
-    
-    DdNode* dead_mask = bdd_mgr.BuildDeadlockMask(input_matrix);
-    bdd_mgr.Ref(dead_mask);
-    
-    DdNode* intersection = Cudd_bddAnd(bdd_mgr.manager, reachable_bdd, dead_mask);
-    bdd_mgr.Ref(intersection);
-    
-    if (intersection != bdd_mgr.GetZero()) {
+    std::vector<CoverabilityResult> parts(components.size());
+    ForEachComponent(components, threads, [&](size_t k, const PetriNetAnalysis& sub) {
+        parts[k] = sub.ComputeCoverability();
+    });
+
+    CoverabilityResult res = CoverabilityResult();
+    res.place_bounds.assign(places.size(), 0);
+    for (size_t k = 0; k < components.size(); ++k) {
+        const std::vector<int>& ps = components[k].places;
+        for (size_t i = 0; i < ps.size(); ++i) res.place_bounds[ps[i]] = parts[k].place_bounds[i];
+        if (parts[k].stats.aborted && !res.stats.aborted) {
+            res.stats.aborted = true;
+            res.stats.reason = parts[k].stats.reason;
+        }
+        res.nodes += parts[k].nodes;
+        res.stats.frontier += parts[k].stats.frontier;
+        res.stats.depth = std::max(res.stats.depth, parts[k].stats.depth);
+    }
+    for (size_t p = 0; p < places.size(); ++p) {
+        if (res.place_bounds[p] == OMEGA) res.unbounded_places.push_back(p);
+    }
+    res.bounded = res.unbounded_places.empty() && !res.stats.aborted;
+    res.stats.states = res.nodes;
+    auto end = std::chrono::high_resolution_clock::now();
+    res.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    return res;
+}
+
+// Karp-Miller graph with subsumption: a new node equal to a kept node, or
+// covered by an active omega-node, is not expanded again, since every sequence
+// fireable from it is fireable from the covering node. Nodes are never removed,
+// so acceleration against ancestors stays sound.
+//
+// Equality goes through the Zobrist hash. Coverage is only tested against
+// omega-nodes, which are few: comparing finite nodes pairwise would cost
+// O(n^2) on bounded nets and is not needed for termination. All tests are
+// filtered by weight = finite token sum + 2^32 per omega place, since
+// a <= b implies weight(a) <= weight(b).
+namespace {
+struct KMNode {
+    Marking m;
+    int parent;
+    int depth;
+    uint64_t weight;
+};
+
+uint64_t OmegaWeight(const Marking& m) {
+    uint64_t w = 0;
+    for (int v : m) w += (v == OMEGA) ? (1ULL << 32) : (uint64_t)v;
+    return w;
+}
+
+bool Covers(const Marking& big, const Marking& small) {
+    for (size_t p = 0; p < big.size(); ++p) if (big[p] < small[p]) return false;
+    return true;
+}
+}
+
+CoverabilityResult PetriNetAnalysis::ComputeCoverability() const {
+    auto start = std::chrono::high_resolution_clock::now();
+    CoverabilityResult res;
+    res.stats = RunStats();
+    BudgetGuard guard(budget);
+    std::vector<KMNode> nodes;
+    std::vector<char> active;                           // not covered by a later omega-node
+    std::vector<int> omega_nodes;                       // active nodes with at least one omega
+    std::unordered_multimap<uint64_t, int> by_hash;     // all kept nodes
+    std::queue<int> work;
+
+    auto add_node = [&](Marking&& m, int parent, uint64_t w, uint64_t h) {
+        int id = nodes.size();
+        nodes.push_back({std::move(m), parent, parent < 0 ? 0 : nodes[parent].depth + 1, w});
+        active.push_back(1);
+        by_hash.emplace(h, id);
+        work.push(id);
+        return id;
+    };
+    add_node(Marking(initial_marking), -1, OmegaWeight(initial_marking), HashMarking(initial_marking));
+
+    while (!work.empty() && !guard.Exceeded(nodes.size(), res.stats)) {
+        int u = work.front(); work.pop();
+        res.stats.depth = nodes[u].depth;
+        if (!active[u]) continue;
+        for (size_t t = 0; t < transitions.size(); ++t) {
+            if (!IsEnabled(nodes[u].m, t)) continue;
+            Marking v = nodes[u].m;
+            for (const auto& d : delta_places[t]) if (v[d.first] != OMEGA) v[d.first] += d.second;
+
+            // Accelerate against every strictly smaller ancestor, until stable
+            uint64_t wv = OmegaWeight(v);
+            bool accelerated = false;
+            for (bool changed = true; changed; ) {
+                changed = false;
+                for (int a = u; a != -1 && !changed; a = nodes[a].parent) {
+                    if (nodes[a].weight >= wv || !Covers(v, nodes[a].m)) continue;
+                    for (size_t p = 0; p < v.size(); ++p) {
+                        if (v[p] != OMEGA && nodes[a].m[p] < v[p]) { v[p] = OMEGA; changed = true; }
+                    }
+                }
+                if (changed) { wv = OmegaWeight(v); accelerated = true; }
+            }
+
+            uint64_t hv = HashMarking(v);
+            bool covered = false;
+            auto range = by_hash.equal_range(hv);
+            for (auto it = range.first; it != range.second && !covered; ++it) covered = nodes[it->second].m == v;
+            for (size_t i = 0; i < omega_nodes.size() && !covered; ++i) {
+                const KMNode& a = nodes[omega_nodes[i]];
+                covered = a.weight > wv && Covers(a.m, v);
+            }
+            if (covered) continue;
+
+            bool has_omega = accelerated || wv >= (1ULL << 32);
+            if (has_omega) {
+                // v leaves every node it covers out of the result; nodes still
+                // queued are skipped since v's subtree covers theirs
+                for (size_t a = 0; a < nodes.size(); ++a) {
+                    if (active[a] && nodes[a].weight < wv && Covers(v, nodes[a].m)) active[a] = 0;
+                }
+                omega_nodes.erase(std::remove_if(omega_nodes.begin(), omega_nodes.end(),
+                                                 [&](int a) { return !active[a]; }), omega_nodes.end());
+            }
+            int id = add_node(std::move(v), u, wv, hv);
+            if (has_omega) omega_nodes.push_back(id);
+        }
+    }
+
+    res.place_bounds.assign(places.size(), 0);
+    for (size_t a = 0; a < nodes.size(); ++a) {
+        if (!active[a]) continue;
+        res.maximal.push_back(nodes[a].m);
+        for (size_t p = 0; p < places.size(); ++p) res.place_bounds[p] = std::max(res.place_bounds[p], nodes[a].m[p]);
+    }
+    for (size_t p = 0; p < places.size(); ++p) {
+        if (res.place_bounds[p] == OMEGA) res.unbounded_places.push_back(p);
+    }
+    // An omega proves unboundedness even if the budget stopped the search
+    res.bounded = res.unbounded_places.empty() && !res.stats.aborted;
+    res.nodes = nodes.size();
+    res.stats.states = nodes.size();
+    res.stats.frontier = work.size();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    res.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    return res;
+}
+
+bool ReachabilityGraph::WriteBinary(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        std::cerr << "[ERROR] Could not open file: " << filename << "\n";
+        return false;
+    }
+    uint32_t version = 2, n = NumStates(), x = expanded;
+    uint64_t e = NumEdges();
+    out.write("PNRG", 4);
+    out.write((const char*)&version, sizeof(version));
+    out.write((const char*)&n, sizeof(n));
+    out.write((const char*)&x, sizeof(x));
+    out.write((const char*)&e, sizeof(e));
+    out.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+    out.write((const char*)targets.data(), targets.size() * sizeof(uint32_t));
+    out.write((const char*)labels.data(), labels.size() * sizeof(uint32_t));
+    return (bool)out;
+}
+
+bool ReachabilityGraph::WriteDot(const std::string& filename, const std::vector<Place>& places,
+                                 const std::vector<Transition>& transitions, const StateStore& states) const {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "[ERROR] Could not open file: " << filename << "\n";
+        return false;
+    }
+    out << "digraph reachability {\n";
+    for (size_t s = 0; s < NumStates(); ++s) {
+        // Label each state with its marked places
+        out << "  s" << s << " [label=\"s" << s << "\\n";
+        bool first = true;
+        const int* m = states.Data(s);
+        for (size_t p = 0; p < places.size(); ++p) {
+            if (m[p] == 0) continue;
+            out << (first ? "" : " ") << places[p].id;
+            if (m[p] > 1) out << "=" << m[p];
+            first = false;
+        }
+        out << "\"" << (s >= expanded ? ", style=dashed" : "") << "];\n";
+    }
+    for (size_t s = 0; s < NumStates(); ++s) {
+        for (uint64_t e = offsets[s]; e < offsets[s + 1]; ++e) {
+            out << "  s" << s << " -> s" << targets[e] << " [label=\"" << transitions[labels[e]].id << "\"];\n";
+        }
+    }
+    out << "}\n";
+    return (bool)out;
+}
+
+// REDUCTION
+Marking NetReduction::Expand(const Marking& m) const {
+    if (!Active() || m.size() != num_places) return m;
+    Marking out(place_base.size());
+    for (size_t p = 0; p < place_base.size(); ++p) {
+        out[p] = (place_base[p] >= 0 ? m[place_base[p]] : 0) + place_offset[p];
+    }
+    return out;
+}
+
+bool NetReduction::Project(const Marking& orig, Marking& reduced) const {
+    if (!Active()) { reduced = orig; return true; }
+    if (orig.size() != place_base.size()) return false;
+    reduced.assign(num_places, 0);
+    for (size_t p = 0; p < place_base.size(); ++p) {
+        if (place_kept[p]) reduced[place_base[p]] = orig[p];
+    }
+    return Expand(reduced) == orig;
+}
+
+std::vector<int> NetReduction::MapObjective(const std::vector<int>& c, long long& offset) const {
+    offset = 0;
+    if (!Active()) return c;
+    std::vector<int> out(num_places, 0);
+    for (size_t p = 0; p < place_base.size() && p < c.size(); ++p) {
+        if (place_base[p] >= 0) out[place_base[p]] += c[p];
+        offset += (long long)c[p] * place_offset[p];
+    }
+    return out;
+}
+
+std::string NetReduction::TransitionLabel(int t, const std::string& reduced_id) const {
+    if (!Active()) return reduced_id;
+    std::string label;
+    for (int u : transition_seq[t]) {
+        if (!label.empty()) label += ' ';
+        label += transition_ids[u];
+    }
+    return label;
+}
+
+// Rules work on copies of the matrices over the original indices; a removed
+// place keeps (base, offset) towards the place it follows, and the chains are
+// resolved once no rule applies any more.
+void PetriNetAnalysis::ReduceNet(const std::vector<std::vector<int>>& objectives, bool exact) {
+    size_t np = places.size(), nt = transitions.size();
+    NetReduction r;
+    r.place_ids = place_ids;
+    r.transition_ids.resize(nt);
+    r.transition_seq.resize(nt);
+    for (size_t t = 0; t < nt; ++t) {
+        r.transition_ids[t] = transitions[t].id;
+        r.transition_seq[t].push_back((int)t);
+    }
+
+    std::vector<std::vector<int>> inc = incidence_matrix, in = input_matrix;
+    std::vector<char> live_p(np, 1), live_t(nt, 1);
+    std::vector<int> base(np, -1), offset(np, 0);
+    // At least one place stays: the engines expect a non-empty marking
+    size_t live_places = np;
+    auto drop_place = [&](size_t p) {
+        live_p[p] = 0;
+        --live_places;
+        std::fill(inc[p].begin(), inc[p].end(), 0);
+        std::fill(in[p].begin(), in[p].end(), 0);
+    };
+    auto resolve = [&](size_t p) {
+        int q = (int)p;
+        while (q >= 0 && !live_p[q]) q = base[q];
+        return q;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        // Constant places. Unmarked ones with consumers are left alone: they
+        // make those transitions dead, which the dead-transition report shows.
+        for (size_t p = 0; p < np; ++p) {
+            if (!live_p[p] || live_places == 1) continue;
+            bool constant = true, consumed = false;
+            for (size_t t = 0; t < nt && constant; ++t) {
+                constant = inc[p][t] == 0;
+                consumed |= in[p][t] > 0;
+            }
+            if (!constant || (consumed && initial_marking[p] == 0)) continue;
+            offset[p] = initial_marking[p];
+            drop_place(p);
+            ++r.constant_places;
+            changed = true;
+        }
+
+        // Parallel places, grouped by a hash of both rows; the least marked
+        // place of a group stays
+        std::vector<int> order;
+        for (size_t p = 0; p < np; ++p) if (live_p[p]) order.push_back((int)p);
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b) { return initial_marking[a] < initial_marking[b]; });
+        std::unordered_map<uint64_t, std::vector<int>> groups;
+        for (int p : order) {
+            uint64_t h = 1469598103934665603ULL;
+            for (size_t t = 0; t < nt; ++t) {
+                h = (h ^ (uint64_t)(inc[p][t] + 2 + 4 * in[p][t])) * 1099511628211ULL;
+            }
+            std::vector<int>& group = groups[h];
+            int rep = -1;
+            for (int q : group) {
+                if (inc[q] == inc[p] && in[q] == in[p]) { rep = q; break; }
+            }
+            if (rep < 0) { group.push_back(p); continue; }
+            base[p] = rep;
+            offset[p] = initial_marking[p] - initial_marking[rep];
+            drop_place(p);
+            ++r.parallel_places;
+            changed = true;
+        }
+
+        if (exact) continue;
+
+        // Series fusion. Objective coefficients are summed onto the live place
+        // each original place follows, so firing t2 is judged on the values
+        // the reduced net can still see.
+        std::vector<std::vector<long long>> eff(objectives.size(), std::vector<long long>(np, 0));
+        for (size_t k = 0; k < objectives.size(); ++k) {
+            for (size_t p = 0; p < np && p < objectives[k].size(); ++p) {
+                int q = resolve(p);
+                if (q >= 0) eff[k][q] += objectives[k][p];
+            }
+        }
+        for (size_t p = 0; p < np; ++p) {
+            if (!live_p[p] || initial_marking[p] != 0 || live_places == 1) continue;
+            int t1 = -1, t2 = -1, producers_seen = 0, consumers_seen = 0;
+            for (size_t t = 0; t < nt; ++t) {
+                if (!live_t[t]) continue;
+                if (inc[p][t] + in[p][t] > 0) { t1 = (int)t; ++producers_seen; }
+                if (in[p][t] > 0) { t2 = (int)t; ++consumers_seen; }
+            }
+            if (producers_seen != 1 || consumers_seen != 1 || t1 == t2) continue;
+            if (inc[p][t1] != 1 || in[p][t1] != 0 || inc[p][t2] != -1) continue;
+
+            bool ok = true;
+            for (size_t q = 0; q < np && ok; ++q) {
+                if (q == p) continue;
+                int v = inc[q][t1] + inc[q][t2];
+                ok = in[q][t2] == 0 && v + in[q][t1] <= 1 && v + in[q][t1] >= 0;
+            }
+            for (size_t k = 0; k < objectives.size() && ok; ++k) {
+                long long delta = 0;
+                for (size_t q = 0; q < np; ++q) delta += eff[k][q] * inc[q][t2];
+                ok = delta >= 0;
+            }
+            if (!ok) continue;
+
+            for (size_t q = 0; q < np; ++q) {
+                inc[q][t1] += inc[q][t2];
+                inc[q][t2] = in[q][t2] = 0;
+            }
+            live_t[t2] = 0;
+            r.transition_seq[t1].insert(r.transition_seq[t1].end(),
+                                        r.transition_seq[t2].begin(), r.transition_seq[t2].end());
+            offset[p] = 0;
+            drop_place(p);
+            ++r.fused_places;
+            changed = true;
+        }
+    }
+
+    std::vector<int> new_index(np, -1);
+    std::vector<Place> kept_places;
+    std::vector<int> kept_p;
+    for (size_t p = 0; p < np; ++p) {
+        if (!live_p[p]) continue;
+        new_index[p] = (int)kept_places.size();
+        kept_p.push_back((int)p);
+        kept_places.push_back(places[p]);
+        kept_places.back().index = new_index[p];
+    }
+    r.place_kept = live_p;
+    r.num_places = kept_places.size();
+    r.place_base.assign(np, -1);
+    r.place_offset.assign(np, 0);
+    for (size_t p = 0; p < np; ++p) {
+        int q = (int)p, off = 0;
+        while (q >= 0 && !live_p[q]) { off += offset[q]; q = base[q]; }
+        r.place_base[p] = q >= 0 ? new_index[q] : -1;
+        r.place_offset[p] = off;
+    }
+
+    std::vector<Transition> kept_transitions;
+    std::vector<std::vector<int>> kept_seq;
+    std::vector<int> kept_t;
+    for (size_t t = 0; t < nt; ++t) {
+        if (!live_t[t]) continue;
+        kept_t.push_back((int)t);
+        kept_transitions.push_back(transitions[t]);
+        kept_transitions.back().index = (int)kept_transitions.size() - 1;
+        kept_seq.push_back(r.transition_seq[t]);
+    }
+    r.transition_seq.swap(kept_seq);
+
+    places.swap(kept_places);
+    transitions.swap(kept_transitions);
+    incidence_matrix.assign(places.size(), std::vector<int>(transitions.size(), 0));
+    input_matrix.assign(places.size(), std::vector<int>(transitions.size(), 0));
+    initial_marking.assign(places.size(), 0);
+    place_ids.clear();
+    place_map.clear();
+    trans_map.clear();
+    for (const Place& pl : places) {
+        int p = kept_p[pl.index];
+        for (size_t j = 0; j < kept_t.size(); ++j) {
+            incidence_matrix[pl.index][j] = inc[p][kept_t[j]];
+            input_matrix[pl.index][j] = in[p][kept_t[j]];
+        }
+        initial_marking[pl.index] = pl.initial_marking;
+        place_ids.push_back(pl.id);
+        place_map[pl.id] = pl.index;
+    }
+    for (const Transition& tr : transitions) trans_map[tr.id] = tr.index;
+    BuildSparseArcs();
+
+    reduction = std::move(r);
+    objective_vector = reduction.MapObjective(objective_vector, reduction.objective_offset);
+}
+
+// INVARIANTS
+namespace {
+typedef std::vector<std::pair<int, long long>> SparseVec;
+
+// A row of the Farkas tableau: what is left of the matrix, and the
+// combination of generators (places or transitions) that produced it
+struct FarkasRow {
+    SparseVec coeff;                 // remaining columns, sorted
+    SparseVec weight;                // generator weights, sorted
+    std::vector<uint64_t> support;   // bitset of the generators in `weight`
+    int size;                        // popcount of support
+};
+
+long long Gcd(long long a, long long b) {
+    while (b) { long long t = a % b; a = b; b = t; }
+    return a < 0 ? -a : a;
+}
+
+long long CoeffAt(const SparseVec& v, int col) {
+    auto it = std::lower_bound(v.begin(), v.end(), std::make_pair(col, LLONG_MIN));
+    return (it != v.end() && it->first == col) ? it->second : 0;
+}
+
+// out = a*x + b*y, zeros dropped; false on overflow
+bool Combine(long long a, const SparseVec& x, long long b, const SparseVec& y, SparseVec& out) {
+    out.clear();
+    size_t i = 0, j = 0;
+    while (i < x.size() || j < y.size()) {
+        int col;
+        long long vx = 0, vy = 0;
+        if (j == y.size() || (i < x.size() && x[i].first < y[j].first)) { col = x[i].first; vx = x[i++].second; }
+        else if (i == x.size() || y[j].first < x[i].first) { col = y[j].first; vy = y[j++].second; }
+        else { col = x[i].first; vx = x[i++].second; vy = y[j++].second; }
+        long long px, py, sum;
+        if (__builtin_mul_overflow(a, vx, &px) || __builtin_mul_overflow(b, vy, &py) ||
+            __builtin_add_overflow(px, py, &sum)) return false;
+        if (sum != 0) out.push_back(std::make_pair(col, sum));
+    }
+    return true;
+}
+
+bool IsSubset(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+    for (size_t w = 0; w < a.size(); ++w) if (a[w] & ~b[w]) return false;
+    return true;
+}
+
+// rows[g] is row g of the matrix (generator g over num_cols columns)
+InvariantResult Farkas(const std::vector<SparseVec>& rows, size_t num_cols, const ResourceBudget& budget) {
+    auto start = std::chrono::high_resolution_clock::now();
+    InvariantResult res = InvariantResult();
+    BudgetGuard guard(budget, 64);
+    size_t words = (rows.size() + 63) / 64;
+
+    std::vector<FarkasRow> tab(rows.size());
+    for (size_t g = 0; g < rows.size(); ++g) {
+        tab[g].coeff = rows[g];
+        tab[g].weight.push_back(std::make_pair((int)g, 1LL));
+        tab[g].support.assign(words, 0);
+        tab[g].support[g / 64] |= 1ULL << (g % 64);
+        tab[g].size = 1;
+    }
+
+    std::vector<char> done(num_cols, 0);
+    std::vector<long long> pos(num_cols), neg(num_cols);
+    std::vector<FarkasRow> next;
+    for (size_t step = 0; step < num_cols && !res.stats.aborted; ++step) {
+        // Next column: the one whose elimination adds the fewest rows
+        std::fill(pos.begin(), pos.end(), 0);
+        std::fill(neg.begin(), neg.end(), 0);
+        for (const FarkasRow& r : tab) {
+            for (const auto& e : r.coeff) (e.second > 0 ? pos : neg)[e.first]++;
+        }
+        int col = -1;
+        long long best = LLONG_MAX;
+        for (size_t j = 0; j < num_cols; ++j) {
+            if (done[j]) continue;
+            long long growth = pos[j] * neg[j] - pos[j] - neg[j];
+            if (growth < best) { best = growth; col = (int)j; }
+        }
+        if (col < 0) break;
+        done[col] = 1;
+        if (pos[col] == 0 && neg[col] == 0) continue;
+
+        // Rows with a zero in `col` stay, the others are combined in +/- pairs
+        next.clear();
+        std::vector<FarkasRow> fresh;
+        std::vector<size_t> plus, minus;
+        for (size_t r = 0; r < tab.size(); ++r) {
+            long long v = CoeffAt(tab[r].coeff, col);
+            if (v > 0) plus.push_back(r);
+            else if (v < 0) minus.push_back(r);
+            else next.push_back(std::move(tab[r]));
+        }
+        for (size_t a : plus) {
+            if (res.stats.aborted) break;
+            for (size_t b : minus) {
+                const FarkasRow& ra = tab[a];
+                const FarkasRow& rb = tab[b];
+                FarkasRow c;
+                c.support.resize(words);
+                c.size = 0;
+                for (size_t w = 0; w < words; ++w) {
+                    c.support[w] = ra.support[w] | rb.support[w];
+                    c.size += __builtin_popcountll(c.support[w]);
+                }
+                long long va = CoeffAt(ra.coeff, col), vb = -CoeffAt(rb.coeff, col);
+                long long g = Gcd(va, vb);
+                if (!Combine(vb / g, ra.coeff, va / g, rb.coeff, c.coeff) ||
+                    !Combine(vb / g, ra.weight, va / g, rb.weight, c.weight)) {
+                    res.stats.aborted = true;
+                    res.stats.reason = "integer overflow";
+                    break;
+                }
+                long long d = 0;
+                for (const auto& e : c.weight) d = Gcd(d, e.second);
+                for (const auto& e : c.coeff) d = Gcd(d, e.second);
+                if (d > 1) {
+                    for (auto& e : c.weight) e.second /= d;
+                    for (auto& e : c.coeff) e.second /= d;
+                }
+                fresh.push_back(std::move(c));
+                if (guard.Exceeded(next.size() + fresh.size(), res.stats)) break;
+            }
+            if (res.stats.aborted) break;
+        }
+        if (res.stats.aborted) {
+            for (FarkasRow& r : fresh) next.push_back(std::move(r));
+            break;
+        }
+
+        // Keep only minimal supports. Rows carried over were minimal before and
+        // no combination can undercut them (its support contains a parent's),
+        // so only the new rows are tested: against the carried rows and the
+        // new rows kept so far. Equal supports are the same invariant up to
+        // scaling.
+        std::stable_sort(fresh.begin(), fresh.end(),
+                         [](const FarkasRow& x, const FarkasRow& y) { return x.size < y.size; });
+        for (FarkasRow& r : fresh) {
+            bool minimal = true;
+            for (size_t k = 0; k < next.size() && minimal; ++k) {
+                if (next[k].size <= r.size && IsSubset(next[k].support, r.support)) minimal = false;
+            }
+            if (minimal) next.push_back(std::move(r));
+        }
+        tab.swap(next);
+        res.stats.depth = (int)step + 1;
+    }
+
+    // After an abort the step's rows are split between tab and next (moved-from
+    // rows have no weight); any row with nothing left is still an invariant
+    if (res.stats.aborted) for (FarkasRow& r : next) tab.push_back(std::move(r));
+    res.covered.assign(rows.size(), false);
+    for (const FarkasRow& r : tab) {
+        if (!r.coeff.empty() || r.weight.empty()) continue;
+        res.invariants.push_back(r.weight);
+        for (const auto& e : r.weight) res.covered[e.first] = true;
+    }
+    std::sort(res.invariants.begin(), res.invariants.end());
+    res.stats.states = res.invariants.size();
+    res.stats.frontier = tab.size();
+    auto end = std::chrono::high_resolution_clock::now();
+    res.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    return res;
+}
+}
+
+InvariantResult PetriNetAnalysis::ComputePInvariants() const {
+    std::vector<SparseVec> rows(places.size());
+    for (size_t p = 0; p < places.size(); ++p) {
+        for (size_t t = 0; t < transitions.size(); ++t) {
+            if (incidence_matrix[p][t] != 0) rows[p].push_back(std::make_pair((int)t, (long long)incidence_matrix[p][t]));
+        }
+    }
+    return Farkas(rows, transitions.size(), budget);
+}
+
+InvariantResult PetriNetAnalysis::ComputeTInvariants() const {
+    std::vector<SparseVec> rows(transitions.size());
+    for (size_t p = 0; p < places.size(); ++p) {
+        for (size_t t = 0; t < transitions.size(); ++t) {
+            if (incidence_matrix[p][t] != 0) rows[t].push_back(std::make_pair((int)p, (long long)incidence_matrix[p][t]));
+        }
+    }
+    return Farkas(rows, places.size(), budget);
+}
+
+std::vector<std::vector<int>> PetriNetAnalysis::OneTokenBlocks() const {
+    InvariantResult inv = ComputePInvariants();
+    std::vector<std::vector<int>> candidates;
+    for (const auto& y : inv.invariants) {
+        std::vector<int> block;
+        long long tokens = 0;
+        for (const auto& e : y) {
+            if (e.second != 1) { block.clear(); break; }
+            block.push_back(e.first);
+            tokens += initial_marking[e.first];
+        }
+        if (block.empty() || tokens != 1) continue;
+        // y·C = 0 once more, the list may come from an aborted run
+        bool invariant = true;
+        for (size_t t = 0; t < transitions.size() && invariant; ++t) {
+            int sum = 0;
+            for (int p : block) sum += incidence_matrix[p][t];
+            invariant = sum == 0;
+        }
+        if (invariant) candidates.push_back(block);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() > b.size(); });
+
+    std::vector<char> used(places.size(), 0);
+    std::vector<std::vector<int>> blocks;
+    for (const auto& block : candidates) {
+        bool disjoint = true;
+        for (int p : block) disjoint = disjoint && !used[p];
+        if (!disjoint) continue;
+        for (int p : block) used[p] = 1;
+        blocks.push_back(block);
+    }
+    return blocks;
+}
+
+DdNode* PetriNetAnalysis::ComputeSymbolic(long long& time, RunStats* stats, DeadlockResult* early_deadlock) {
+#ifndef NO_CUDD
+    auto start = std::chrono::high_resolution_clock::now();
+    RunStats st = RunStats();
+    BudgetGuard guard(budget, 1);
+    bdd_mgr.Init(places.size(), compact_encoding ? OneTokenBlocks() : std::vector<std::vector<int>>());
+    bdd_mgr.ApplyBudget(budget);
+    for (DdNode* ring : onion_rings) bdd_mgr.Deref(ring);
+    onion_rings.clear();
+    
+    DdNode* M_reach = bdd_mgr.BuildMarkingBDD(initial_marking); bdd_mgr.Ref(M_reach);
+    DdNode* M_new = M_reach; bdd_mgr.Ref(M_new);
+    DdNode* R = bdd_mgr.BuildTransitionRelation(incidence_matrix, input_matrix); bdd_mgr.Ref(R);
+    DdNode* dead_mask = early_deadlock ? bdd_mgr.BuildDeadlockMask(input_matrix) : nullptr;
+    if (!M_reach || !R || (early_deadlock && !dead_mask)) { st.aborted = true; st.reason = bdd_mgr.BudgetError(); }
+    if (early_deadlock) *early_deadlock = DeadlockResult();
+    if (keep_rings && M_new) { bdd_mgr.Ref(M_new); onion_rings.push_back(M_new); }
+    
+    // Fixpoint Iteration
+    while (!st.aborted && M_new != bdd_mgr.GetZero()) { 
+        if (dead_mask) {
+            // Deadlocks first reached at this depth
+            DdNode* dead = Cudd_bddAnd(bdd_mgr.manager, M_new, dead_mask);
+            if (!dead) { st.aborted = true; st.reason = bdd_mgr.BudgetError(); break; }
+            bdd_mgr.Ref(dead);
+            if (dead != bdd_mgr.GetZero()) {
+                early_deadlock->found = true;
+                early_deadlock->deadlock_marking = bdd_mgr.PickOneMarking(dead);
+                early_deadlock->stats.depth = st.depth;
+                st.aborted = true;
+                st.reason = "stopped at first deadlock";
+            }
+            bdd_mgr.Deref(dead);
+            if (st.aborted) break;
+        }
+        if (guard.Exceeded(bdd_mgr.CountStates(M_reach), st)) break;
+        DdNode* M_next = bdd_mgr.SymbolicImage(M_new, R);
+        DdNode* diff = M_next ? bdd_mgr.BDD_Minus(M_next, M_reach) : nullptr;
+        DdNode* u = diff ? bdd_mgr.BDD_Or(M_reach, diff) : nullptr;
+        if (!u) {
+            bdd_mgr.Deref(diff); bdd_mgr.Deref(M_next);
+            st.aborted = true; st.reason = bdd_mgr.BudgetError();
+            break;
+        }
+        
+        if (diff == bdd_mgr.GetZero()) {
+             bdd_mgr.Deref(u); bdd_mgr.Deref(diff); bdd_mgr.Deref(M_next); break; 
+        }
+
+        bdd_mgr.Deref(M_new); M_new = diff;
+        if (keep_rings) { bdd_mgr.Ref(M_new); onion_rings.push_back(M_new); }
+        bdd_mgr.Deref(M_reach); M_reach = u;
+        bdd_mgr.Deref(M_next);
+        st.depth++;
+    }
+    bdd_mgr.ClearBudget();
+    bdd_mgr.Deref(dead_mask);
+    
+    if (M_reach) {
+        st.states = bdd_mgr.CountStates(M_reach);
+        st.frontier = Cudd_DagSize(M_new);
+    } else {
+        // Not even the initial marking fit in the budget
+        M_reach = bdd_mgr.GetZero(); bdd_mgr.Ref(M_reach);
+    }
+    if (stats) *stats = st;
+    auto end = std::chrono::high_resolution_clock::now();
+    time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    if (early_deadlock) {
+        early_deadlock->time_ms = time;
+        if (!early_deadlock->found && st.aborted) {
+            early_deadlock->stats.aborted = true;
+            early_deadlock->stats.reason = st.reason;
+        }
+    }
+    return M_reach;
+#else
+    std::cout << "[WARN] CUDD not found. Skipping Task 3.\n";
+    time = 0;
+    if (stats) *stats = RunStats();
+    if (early_deadlock) *early_deadlock = DeadlockResult();
+    return nullptr;
+#endif
+}
+
+bool PetriNetAnalysis::ShortestTrace(DdNode* target, std::vector<int>& trace, Marking* end) {
+    trace.clear();
+#ifndef NO_CUDD
+    if (!target) return false;
+    // First ring that meets the target
+    size_t k = 0;
+    DdNode* hit = nullptr;
+    for (; k < onion_rings.size(); ++k) {
+        hit = Cudd_bddAnd(bdd_mgr.manager, onion_rings[k], target);
+        if (!hit) return false;
+        bdd_mgr.Ref(hit);
+        if (hit != bdd_mgr.GetZero()) break;
+        bdd_mgr.Deref(hit);
+        hit = nullptr;
+    }
+    if (!hit) return false;
+    Marking m = bdd_mgr.PickOneMarking(hit);
+    bdd_mgr.Deref(hit);
+    if (end) *end = m;
+
+    // Every marking of ring j has a predecessor in ring j-1
+    for (size_t j = k; j > 0; --j) {
+        DdNode* cur = bdd_mgr.BuildMarkingBDD(m);
+        bool stepped = false;
+        for (size_t t = 0; t < transitions.size() && cur && !stepped; ++t) {
+            DdNode* pre = bdd_mgr.PreImage(cur, (int)t, incidence_matrix, input_matrix);
+            DdNode* prev = pre ? Cudd_bddAnd(bdd_mgr.manager, pre, onion_rings[j - 1]) : nullptr;
+            bdd_mgr.Ref(prev);
+            if (prev && prev != bdd_mgr.GetZero()) {
+                m = bdd_mgr.PickOneMarking(prev);
+                trace.push_back((int)t);
+                stepped = true;
+            }
+            bdd_mgr.Deref(prev);
+            bdd_mgr.Deref(pre);
+        }
+        bdd_mgr.Deref(cur);
+        if (!stepped) { trace.clear(); return false; }
+    }
+    std::reverse(trace.begin(), trace.end());
+    return true;
+#else
+    return false;
+#endif
+}
+
+DdNode* BDDWrapper::PreImage(DdNode* set, int t, const std::vector<std::vector<int>>& incidence,
+                             const std::vector<std::vector<int>>& input) {
+#ifndef NO_CUDD
+    // guard: input places marked; post: values the changed variables take;
+    // vars: cube of the changed variables
+    DdNode* guard = Cudd_ReadOne(manager); Cudd_Ref(guard);
+    DdNode* post = Cudd_ReadOne(manager); Cudd_Ref(post);
+    DdNode* vars = Cudd_ReadOne(manager); Cudd_Ref(vars);
+    for (size_t p = 0; p < incidence.size() && guard && post && vars; ++p) {
+        if (input[p][t] > 0) AndInto(manager, guard, marked[p]);
+        int v = place_slot[p];
+        if (v < 0 || (incidence[p][t] != -1 && incidence[p][t] != 1)) continue;
+        AndInto(manager, post, incidence[p][t] == 1 ? x_vars[v] : Cudd_Not(x_vars[v]));
+        AndInto(manager, vars, post ? x_vars[v] : nullptr);
+    }
+    // A changed block holds the code of the place that received the token
+    for (size_t b = 0; b < blocks.size() && guard && post && vars; ++b) {
+        int changed = 0, gains = 0;
+        DdNode* code = nullptr;
+        for (int p : blocks[b]) {
+            if (incidence[p][t] != 0) ++changed;
+            if (incidence[p][t] == 1) { ++gains; code = marked[p]; }
+        }
+        if (!changed) continue;
+        AndInto(manager, post, gains == 1 ? code : Cudd_ReadLogicZero(manager));
+        for (int v : block_slots[b]) AndInto(manager, vars, post ? x_vars[v] : nullptr);
+    }
+    // set with the changed places fixed to their post values, then the guard
+    DdNode* fixed = (guard && post && vars) ? Cudd_bddAndAbstract(manager, set, post, vars) : nullptr;
+    if (fixed) Cudd_Ref(fixed);
+    DdNode* res = fixed ? Cudd_bddAnd(manager, fixed, guard) : nullptr;
+    if (res) Cudd_Ref(res);
+    Deref(fixed); Deref(guard); Deref(post); Deref(vars);
+    return res;
+#else
+    return nullptr;
+#endif
+}
+
+DdNode* BDDWrapper::BuildObjectiveADD(const std::vector<int>& c) {
+#ifndef NO_CUDD
+    DdNode* sum = Cudd_ReadZero(manager);
+    Cudd_Ref(sum);
+    for (size_t p = 0; p < marked.size() && p < c.size() && sum; ++p) {
+        if (c[p] == 0) continue;
+        DdNode* x = Cudd_BddToAdd(manager, marked[p]);
+        if (x) Cudd_Ref(x);
+        DdNode* coef = Cudd_addConst(manager, c[p]);
+        if (coef) Cudd_Ref(coef);
+        DdNode* term = (x && coef) ? Cudd_addApply(manager, Cudd_addTimes, x, coef) : nullptr;
+        if (term) Cudd_Ref(term);
+        DdNode* tmp = term ? Cudd_addApply(manager, Cudd_addPlus, sum, term) : nullptr;
+        if (tmp) Cudd_Ref(tmp);
+        if (x) Cudd_RecursiveDeref(manager, x);
+        if (coef) Cudd_RecursiveDeref(manager, coef);
+        if (term) Cudd_RecursiveDeref(manager, term);
+        Cudd_RecursiveDeref(manager, sum);
+        sum = tmp;
+    }
+    return sum;
+#else
+    return nullptr;
+#endif
+}
+
+DdNode* BDDWrapper::EnablingCondition(int t, const std::vector<std::vector<int>>& input_matrix) {
+#ifndef NO_CUDD
+    size_t num_trans = input_matrix.empty() ? 0 : input_matrix[0].size();
+    if (enabling.size() != num_trans) enabling.assign(num_trans, nullptr);
+    if (enabling[t]) return enabling[t];
+
+    DdNode* t_enabled = Cudd_ReadOne(manager);
+    Cudd_Ref(t_enabled);
+    for (size_t p = 0; p < input_matrix.size() && t_enabled; ++p) {
+        if (input_matrix[p][t] > 0) AndInto(manager, t_enabled, marked[p]);
+    }
+    enabling[t] = t_enabled;
+    return t_enabled;
+#else
+    return nullptr;
+#endif
+}
+
+DdNode* BDDWrapper::BuildDeadlockMask(const std::vector<std::vector<int>>& input_matrix) {
+#ifndef NO_CUDD
+    DdNode* all_dead = Cudd_ReadOne(manager); 
+    Cudd_Ref(all_dead);
+    
+    size_t num_places = input_matrix.size();
+    if (num_places == 0) return all_dead; 
+    size_t num_trans = input_matrix[0].size();
+
+    for (size_t t = 0; t < num_trans; ++t) {
+        DdNode* t_enabled = EnablingCondition((int)t, input_matrix);
+        if (!t_enabled) { Cudd_RecursiveDeref(manager, all_dead); return nullptr; }
+
+        // A transition without input places is always enabled
+        if (t_enabled == Cudd_ReadOne(manager)) {
+            Cudd_RecursiveDeref(manager, all_dead);
+            DdNode* none = Cudd_ReadLogicZero(manager);
+            Cudd_Ref(none);
+            return none;
+        }
+        
+        DdNode* tmp_dead = Cudd_bddAnd(manager, all_dead, Cudd_Not(t_enabled)); 
+        if (tmp_dead) Cudd_Ref(tmp_dead);
+        Cudd_RecursiveDeref(manager, all_dead);
+        
+        all_dead = tmp_dead;
+        if (!all_dead) return nullptr;
+    }
+    
+    return all_dead;
+#else
+    return nullptr;
+#endif
+}
+
+Marking BDDWrapper::PickOneMarking(DdNode* bdd) {
+    Marking m(place_slot.size(), 0);
+#ifndef NO_CUDD
+    if (!bdd || bdd == Cudd_ReadLogicZero(manager)) return m;
+
+    // Walk one satisfying path, preferring the 1-branch; plain places off the
+    // path are free and also set to 1, block bits off the path to 0 (code 0
+    // always exists). No node is created.
+    std::vector<char> bits(x_vars.size(), 0);
+    for (int v : place_slot) if (v >= 0) bits[v] = 1;
+    DdNode* zero = Cudd_ReadLogicZero(manager);
+    DdNode* f = bdd;
+    while (!Cudd_IsConstant(Cudd_Regular(f))) {
+        DdNode* r = Cudd_Regular(f);
+        DdNode* t = Cudd_IsComplement(f) ? Cudd_Not(Cudd_T(r)) : Cudd_T(r);
+        DdNode* e = Cudd_IsComplement(f) ? Cudd_Not(Cudd_E(r)) : Cudd_E(r);
+        bool one = t != zero;
+        int v = SlotOfVar(Cudd_NodeReadIndex(r));
+        if (v >= 0) bits[v] = one ? 1 : 0;
+        f = one ? t : e;
+    }
+    Decode(bits, m);
+#endif
+    return m;
+}
+
+std::vector<Marking> BDDWrapper::SampleMarkings(DdNode* set, size_t count, uint64_t seed) {
+    std::vector<Marking> samples;
+#ifndef NO_CUDD
+    if (!set || set == Cudd_ReadLogicZero(manager) || count == 0) return samples;
+
+    // density(f) = fraction of all assignments satisfying f, as a natural log:
+    // |f| / 2^n underflows a double once there are about 1000 variables. Each
+    // node keeps the log density of itself and of its complement, so a
+    // complemented edge needs no 1 - d (which would cancel to 0 or 1)
+    const double NONE = -std::numeric_limits<double>::infinity();
+    auto log_add = [NONE](double a, double b) {
+        if (a < b) std::swap(a, b);
+        return b == NONE ? a : a + std::log1p(std::exp(b - a));
+    };
+    std::unordered_map<DdNode*, std::pair<double, double>> density;
+    std::function<double(DdNode*)> dens = [&](DdNode* f) -> double {
+        DdNode* r = Cudd_Regular(f);
+        std::pair<double, double> d(0.0, NONE);
+        if (!Cudd_IsConstant(r)) {
+            auto it = density.find(r);
+            if (it != density.end()) {
+                d = it->second;
+            } else {
+                // mean of the children, for r and for its complement
+                DdNode* t = Cudd_T(r);
+                DdNode* e = Cudd_E(r);
+                d.first = log_add(dens(t), dens(e)) - std::log(2.0);
+                d.second = log_add(dens(Cudd_Not(t)), dens(Cudd_Not(e))) - std::log(2.0);
+                density[r] = d;
+            }
+        }
+        return Cudd_IsComplement(f) ? d.second : d.first;
+    };
+    dens(set);
+
+    // Each step takes a branch with probability proportional to its minterms;
+    // variables skipped on the path keep a fair coin flip
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    samples.reserve(count);
+    for (size_t k = 0; k < count; ++k) {
+        std::vector<char> bits(x_vars.size());
+        for (char& b : bits) b = (char)(rng() & 1);
+        DdNode* f = set;
+        while (!Cudd_IsConstant(Cudd_Regular(f))) {
+            DdNode* r = Cudd_Regular(f);
+            DdNode* t = Cudd_IsComplement(f) ? Cudd_Not(Cudd_T(r)) : Cudd_T(r);
+            DdNode* e = Cudd_IsComplement(f) ? Cudd_Not(Cudd_E(r)) : Cudd_E(r);
+            double dt = dens(t), de = dens(e);
+            // P(then) = dt / (dt + de); an empty branch is never taken
+            double p_then = dt == NONE ? 0.0 : std::exp(dt - log_add(dt, de));
+            bool one = unit(rng) < p_then;
+            int v = SlotOfVar(Cudd_NodeReadIndex(r));
+            if (v >= 0) bits[v] = one ? 1 : 0;
+            f = one ? t : e;
+        }
+        assert(f == Cudd_ReadOne(manager));
+        Marking m;
+        Decode(bits, m);
+        samples.push_back(std::move(m));
+    }
+#endif
+    return samples;
+}
+
+PetriNetAnalysis::~PetriNetAnalysis() {
+#ifdef USE_GLPK
+    if (deadlock_lp) glp_delete_prob(deadlock_lp);
+#endif
+}
+
+#ifdef USE_GLPK
+void PetriNetAnalysis::BuildDeadlockLP() {
+    deadlock_lp = glp_create_prob();
+    glp_set_prob_name(deadlock_lp, "Deadlock_Verification");
+    glp_set_obj_dir(deadlock_lp, GLP_MAX);
+    glp_term_out(GLP_OFF);
+
+    int T = transitions.size();
+    glp_add_cols(deadlock_lp, T);
+    for (int t = 0; t < T; ++t) {
+        glp_set_col_kind(deadlock_lp, t + 1, GLP_BV);
+        glp_set_obj_coef(deadlock_lp, t + 1, 1.0);
+    }
+
+    // One row x_t <= m_p per input arc, all added in one call; the bound is
+    // set per query. Start from the all-empty marking.
+    int arcs = 0;
+    for (int t = 0; t < T; ++t) arcs += pre_places[t].size();
+    deadlock_rows.assign(places.size(), std::vector<int>());
+    if (arcs > 0) glp_add_rows(deadlock_lp, arcs);
+    int row = 0;
+    for (int t = 0; t < T; ++t) {
+        for (int p : pre_places[t]) {
+            ++row;
+            int ind[2] = {0, t + 1};
+            double val[2] = {0.0, 1.0};
+            glp_set_mat_row(deadlock_lp, row, 1, ind, val);
+            glp_set_row_bnds(deadlock_lp, row, GLP_UP, 0.0, 0.0);
+            deadlock_rows[p].push_back(row);
+        }
+    }
+    deadlock_lp_marking.assign(places.size(), 0);
+}
+
+bool PetriNetAnalysis::IsDeadlockByILP(const Marking& m) {
+    int T = transitions.size();
+    if (T == 0) return true;
+    if (!deadlock_lp) BuildDeadlockLP();
+
+    for (size_t p = 0; p < places.size(); ++p) {
+        bool marked = m[p] > 0;
+        if (marked == (deadlock_lp_marking[p] > 0)) continue;
+        for (int row : deadlock_rows[p]) glp_set_row_bnds(deadlock_lp, row, GLP_UP, 0.0, marked ? 1.0 : 0.0);
+        deadlock_lp_marking[p] = marked;
+    }
+
+    // Warm start: no presolve, so the simplex continues from the last basis
+    // and the MIP search starts from that LP optimum
+    glp_smcp smcp;
+    glp_init_smcp(&smcp);
+    smcp.msg_lev = GLP_MSG_OFF;
+    glp_iocp parm;
+    glp_init_iocp(&parm);
+    parm.msg_lev = GLP_MSG_OFF;
+    parm.presolve = GLP_OFF;
+
+    bool is_deadlock = true;
+    if (glp_simplex(deadlock_lp, &smcp) == 0 && glp_get_status(deadlock_lp) == GLP_OPT &&
+        glp_intopt(deadlock_lp, &parm) == 0) {
+        double max_enabled = glp_mip_obj_val(deadlock_lp);
+        if (max_enabled > 0.5) {
+            is_deadlock = false;
+        }
+    }
+    return is_deadlock;
+}
+
+std::vector<bool> PetriNetAnalysis::AreDeadlocksByILP(const std::vector<Marking>& candidates) {
+    std::vector<bool> result;
+    result.reserve(candidates.size());
+    for (const auto& m : candidates) result.push_back(IsDeadlockByILP(m));
+    return result;
+}
+#endif
+
+#ifdef USE_GLPK
+PetriNetAnalysis::DeadlockResult PetriNetAnalysis::CheckSiphonTrap(int max_siphons) {
+    auto start = std::chrono::high_resolution_clock::now();
+    DeadlockResult result = DeadlockResult();
+    int P = (int)places.size(), T = (int)transitions.size();
+    auto finish = [&]() {
+        auto end = std::chrono::high_resolution_clock::now();
+        result.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        return result;
+    };
+
+    if (T == 0) {
+        result.stats.aborted = true;
+        result.stats.reason = "no transitions";
+        return finish();
+    }
+    // A transition without input places is always enabled
+    for (int t = 0; t < T; ++t) if (pre_places[t].empty()) return finish();
+
+    // s_p = 1 iff p is in the siphon. For every arc t -> p:
+    // s_p <= sum_{q in •t} s_q, i.e. a place fed by t needs an input of t.
+    glp_prob* lp = glp_create_prob();
+    glp_set_obj_dir(lp, GLP_MIN);
+    glp_add_cols(lp, P);
+    for (int p = 0; p < P; ++p) {
+        glp_set_col_kind(lp, p + 1, GLP_BV);
+        glp_set_obj_coef(lp, p + 1, 1.0);
+    }
+    for (int t = 0; t < T; ++t) {
+        for (int p : post_places[t]) {
+            // A self-loop on p satisfies the arc on its own
+            if (input_matrix[p][t] > 0) continue;
+            std::vector<int> ind(1, 0);
+            std::vector<double> val(1, 0.0);
+            ind.push_back(p + 1); val.push_back(1.0);
+            for (int q : pre_places[t]) { ind.push_back(q + 1); val.push_back(-1.0); }
+            int row = glp_add_rows(lp, 1);
+            glp_set_mat_row(lp, row, (int)ind.size() - 1, ind.data(), val.data());
+            glp_set_row_bnds(lp, row, GLP_UP, 0.0, 0.0);
+        }
+    }
+    // Non-empty
+    {
+        std::vector<int> ind(P + 1);
+        std::vector<double> val(P + 1, 1.0);
+        for (int p = 0; p < P; ++p) ind[p + 1] = p + 1;
+        int row = glp_add_rows(lp, 1);
+        glp_set_mat_row(lp, row, P, ind.data(), val.data());
+        glp_set_row_bnds(lp, row, GLP_LO, 1.0, 0.0);
+    }
+
+    glp_smcp smcp;
+    glp_init_smcp(&smcp);
+    smcp.msg_lev = GLP_MSG_OFF;
+    glp_iocp iocp;
+    glp_init_iocp(&iocp);
+    iocp.msg_lev = GLP_MSG_OFF;
+    iocp.presolve = GLP_OFF;
+    if (budget.time_limit_ms) iocp.tm_lim = (int)std::min<long long>(budget.time_limit_ms, INT_MAX);
+    BudgetGuard guard(budget, 1);
+    RunStats limits = RunStats();
+
+    result.stats.aborted = true;
+    result.stats.reason = "siphon limit";
+    for (int round = 1; round <= max_siphons; ++round) {
+        if (guard.Exceeded(0, limits)) { result.stats.reason = limits.reason; break; }
+        glp_simplex(lp, &smcp);
+        if (glp_get_status(lp) == GLP_NOFEAS) { result.stats.aborted = false; result.stats.reason.clear(); break; }
+        if (glp_get_status(lp) != GLP_OPT) { result.stats.reason = "LP relaxation failed"; break; }
+        int ret = glp_intopt(lp, &iocp);
+        if (ret == 0 && glp_mip_status(lp) == GLP_NOFEAS) { result.stats.aborted = false; result.stats.reason.clear(); break; }
+        if (ret != 0 || glp_mip_status(lp) != GLP_OPT) { result.stats.reason = "ILP failed"; break; }
+
+        // Shrink to a minimal siphon: drop a place whenever the largest
+        // siphon left without it is still non-empty
+        std::vector<char> siphon(P, 0);
+        for (int p = 0; p < P; ++p) siphon[p] = glp_mip_col_val(lp, p + 1) > 0.5;
+        for (int p = 0; p < P; ++p) {
+            if (!siphon[p]) continue;
+            std::vector<char> rest = siphon;
+            rest[p] = 0;
+            rest = MaxSiphonIn(rest);
+            if (std::find(rest.begin(), rest.end(), 1) != rest.end()) siphon.swap(rest);
+        }
+        result.stats.depth = round;
+        result.stats.states = round;
+
+        std::vector<char> trap = MaxTrapIn(siphon);
+        bool marked = false;
+        for (int p = 0; p < P && !marked; ++p) marked = trap[p] && initial_marking[p] > 0;
+        if (!marked) {
+            std::string ids;
+            for (int p = 0; p < P; ++p) if (siphon[p]) ids += (ids.empty() ? "" : " ") + places[p].id;
+            result.stats.reason = "siphon {" + ids + "} holds no marked trap";
+            break;
+        }
+
+        // Exclude this siphon and its supersets: sum_{p in S} s_p <= |S| - 1
+        std::vector<int> ind(1, 0);
+        std::vector<double> val(1, 0.0);
+        for (int p = 0; p < P; ++p) if (siphon[p]) { ind.push_back(p + 1); val.push_back(1.0); }
+        int row = glp_add_rows(lp, 1);
+        glp_set_mat_row(lp, row, (int)ind.size() - 1, ind.data(), val.data());
+        glp_set_row_bnds(lp, row, GLP_UP, 0.0, ind.size() - 2.0);
+    }
+    glp_delete_prob(lp);
+    return finish();
+}
+
+glp_prob* PetriNetAnalysis::BuildStateEquation(const std::vector<int>& place_bounds) const {
+    int P = (int)places.size(), T = (int)transitions.size();
+    glp_prob* lp = glp_create_prob();
+    glp_set_prob_name(lp, "State_Equation");
+    glp_set_obj_dir(lp, GLP_MAX);
+    glp_term_out(GLP_OFF);
+
+    glp_add_cols(lp, P + T);
+    for (int p = 0; p < P; ++p) {
+        int b = p < (int)place_bounds.size() ? place_bounds[p] : OMEGA;
+        glp_set_col_kind(lp, p + 1, GLP_IV);
+        if (b == OMEGA) glp_set_col_bnds(lp, p + 1, GLP_LO, 0.0, 0.0);
+        else if (b == 0) glp_set_col_bnds(lp, p + 1, GLP_FX, 0.0, 0.0);
+        else glp_set_col_bnds(lp, p + 1, GLP_DB, 0.0, b);
+    }
+    for (int t = 0; t < T; ++t) {
+        glp_set_col_kind(lp, P + t + 1, GLP_IV);
+        glp_set_col_bnds(lp, P + t + 1, GLP_LO, 0.0, 0.0);
+    }
+
+    // m_p - sum_t C[p][t] * sigma_t = m0_p
+    std::vector<int> ind(T + 2);
+    std::vector<double> val(T + 2);
+    glp_add_rows(lp, P);
+    for (int p = 0; p < P; ++p) {
+        int len = 0;
+        ind[++len] = p + 1; val[len] = 1.0;
+        for (int t = 0; t < T; ++t) {
+            if (incidence_matrix[p][t] != 0) { ind[++len] = P + t + 1; val[len] = -incidence_matrix[p][t]; }
+        }
+        glp_set_mat_row(lp, p + 1, len, ind.data(), val.data());
+        glp_set_row_bnds(lp, p + 1, GLP_FX, initial_marking[p], initial_marking[p]);
+    }
+    return lp;
+}
+
+void PetriNetAnalysis::AddNoGoodCut(glp_prob* lp, const Marking& m) {
+    // sum_{m_p = 1} (1 - x_p) + sum_{m_p = 0} x_p >= 1
+    int n = (int)m.size(), ones = 0;
+    std::vector<int> ind(n + 1);
+    std::vector<double> val(n + 1);
+    for (int p = 0; p < n; ++p) {
+        ind[p + 1] = p + 1;
+        val[p + 1] = m[p] ? -1.0 : 1.0;
+        ones += m[p];
+    }
+    int row = glp_add_rows(lp, 1);
+    glp_set_mat_row(lp, row, n, ind.data(), val.data());
+    glp_set_row_bnds(lp, row, GLP_LO, 1.0 - ones, 0.0);
+}
+
+PetriNetAnalysis::DeadlockResult PetriNetAnalysis::DetectDeadlockILP(const std::vector<int>& place_bounds,
+                                                                     DdNode* reachable_bdd, int max_rounds) {
+    auto start = std::chrono::high_resolution_clock::now();
+    DeadlockResult result = DeadlockResult();
+    int P = (int)places.size(), T = (int)transitions.size();
+    auto finish = [&]() {
+        auto end = std::chrono::high_resolution_clock::now();
+        result.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        return result;
+    };
+
+    // A transition without input places is always enabled
+    for (int t = 0; t < T; ++t) if (pre_places[t].empty()) return finish();
+    // "m_p = 0" needs a finite cap on m_p
+    bool safe = (int)place_bounds.size() == P;
+    for (int t = 0; t < T; ++t) {
+        for (int p : pre_places[t]) {
+            if (p >= (int)place_bounds.size() || place_bounds[p] == OMEGA) {
+                result.stats.aborted = true;
+                result.stats.reason = "place bounds unknown";
+                return finish();
+            }
+        }
+    }
+    for (int b : place_bounds) if (b > 1) safe = false;
+
+    glp_prob* lp = BuildStateEquation(place_bounds);
+
+    // z_p = 0 forces m_p = 0 through m_p <= bound_p * z_p. 1-bounded places
+    // serve as their own indicator.
+    std::vector<int> empty_col(P, 0);
+    for (int p = 0; p < P; ++p) empty_col[p] = p + 1;
+    for (int t = 0; t < T; ++t) {
+        for (int p : pre_places[t]) {
+            if (place_bounds[p] <= 1 || empty_col[p] != p + 1) continue;
+            int z = glp_add_cols(lp, 1);
+            glp_set_col_kind(lp, z, GLP_BV);
+            int row = glp_add_rows(lp, 1);
+            int ind[3] = {0, p + 1, z};
+            double val[3] = {0.0, 1.0, -(double)place_bounds[p]};
+            glp_set_mat_row(lp, row, 2, ind, val);
+            glp_set_row_bnds(lp, row, GLP_UP, 0.0, 0.0);
+            empty_col[p] = z;
+        }
+    }
+    // Every transition disabled: at least one input place holds no token
+    for (int t = 0; t < T; ++t) {
+        std::vector<int> ind(1, 0);
+        std::vector<double> val(1, 0.0);
+        for (int p : pre_places[t]) { ind.push_back(empty_col[p]); val.push_back(1.0); }
+        int row = glp_add_rows(lp, 1);
+        glp_set_mat_row(lp, row, (int)pre_places[t].size(), ind.data(), val.data());
+        glp_set_row_bnds(lp, row, GLP_UP, 0.0, pre_places[t].size() - 1.0);
+    }
+
+    glp_smcp smcp;
+    glp_init_smcp(&smcp);
+    smcp.msg_lev = GLP_MSG_OFF;
+    glp_iocp iocp;
+    glp_init_iocp(&iocp);
+    iocp.msg_lev = GLP_MSG_OFF;
+    iocp.presolve = GLP_OFF;
+
+    // Every solve and reachability check of all rounds is charged to one
+    // deadline: each step only gets the time left
+    BudgetGuard guard(budget);
+    ResourceBudget left = budget;
+    auto out_of_time = [&]() { return guard.RemainingMs() <= 0; };
+
+    result.stats.aborted = true;
+    result.stats.reason = "round limit";
+    for (int round = 1; round <= max_rounds; ++round) {
+        result.stats.depth = round;
+        if (out_of_time()) { result.stats.reason = "time limit"; break; }
+        if (budget.time_limit_ms) {
+            left.time_limit_ms = guard.RemainingMs();
+            smcp.tm_lim = iocp.tm_lim = (int)std::min<long long>(left.time_limit_ms, INT_MAX);
+        }
+        glp_simplex(lp, &smcp);
+        if (glp_get_status(lp) == GLP_NOFEAS) { result.stats.aborted = false; break; }
+        if (glp_get_status(lp) != GLP_OPT) {
+            result.stats.reason = out_of_time() ? "time limit" : "LP relaxation failed";
+            break;
+        }
+        int ret = glp_intopt(lp, &iocp);
+        if (ret == 0 && glp_mip_status(lp) == GLP_NOFEAS) { result.stats.aborted = false; break; }
+        if (ret != 0 || glp_mip_status(lp) != GLP_OPT) {
+            result.stats.reason = out_of_time() ? "time limit" : "ILP failed";
+            break;
+        }
+
+        Marking cand(P);
+        for (int p = 0; p < P; ++p) cand[p] = (int)std::lround(glp_mip_col_val(lp, p + 1));
+        // A complete reachable-set BDD decides membership exactly
+        int reach = reachable_bdd ? (bdd_mgr.Contains(reachable_bdd, cand) ? 1 : 0)
+                                  : ReachesMarking(cand, nullptr, &left);
+        if (reach == 1) {
+            result.found = true;
+            result.deadlock_marking = cand;
+            result.stats.aborted = false;
+            break;
+        }
+        if (reach < 0) {
+            result.stats.reason = out_of_time() ? "time limit" : "reachability check over budget";
+            break;
+        }
+        if (!safe) { result.stats.reason = "spurious solution on a net that is not 1-bounded"; break; }
+        AddNoGoodCut(lp, cand);
+    }
+    glp_delete_prob(lp);
+    return finish();
+}
+#endif
+
+PetriNetAnalysis::DeadlockResult PetriNetAnalysis::DetectDeadlock(DdNode* reachable_bdd) {
+    auto start = std::chrono::high_resolution_clock::now();
+    DeadlockResult result = DeadlockResult();
+    
+#ifndef NO_CUDD
+    std::cout << "[Task 4] Using BDD to generate deadlock candidates ...\n";
+    bdd_mgr.ApplyBudget(budget);
+    DdNode* intersection = DeadlockSet(reachable_bdd);
+    if (!intersection) {
+        result.stats.aborted = true;
+        result.stats.reason = bdd_mgr.BudgetError();
+    }
+    bdd_mgr.ClearBudget();
+    
+    if (!intersection) {
+        std::cout << "[Task 4] Aborted (" << result.stats.reason << ").\n";
+    } else if (intersection != bdd_mgr.GetZero()) {
+        result.count = bdd_mgr.CountStates(intersection);
         Marking candidate = bdd_mgr.PickOneMarking(intersection);
         
 #ifdef USE_GLPK
         std::cout << "[Task 4] Using GLPK ILP to verify deadlock...\n";
         
-        if (IsDeadlockByILP(candidate)) {
+        // Up to 64 candidates are verified in one batch on the warm-started
+        // model, so one false positive does not hide the other deadlocks
+        std::vector<Marking> candidates;
+        bdd_mgr.ForEachMarking(intersection, 64, [&](const Marking& m) { candidates.push_back(m); return true; });
+        if (candidates.empty()) candidates.push_back(candidate);
+        std::vector<bool> dead = AreDeadlocksByILP(candidates);
+        size_t k = std::find(dead.begin(), dead.end(), true) - dead.begin();
+        if (k < candidates.size()) {
             result.found = true;
-            result.deadlock_marking = candidate;
-            std::cout << "[Task 4] Deadlock CONFIRMED by ILP.\n";
+            result.deadlock_marking = candidates[k];
+            std::cout << "[Task 4] Deadlock CONFIRMED by ILP (" << k << " of " << candidates.size()
+                      << " candidates rejected first).\n";
         } else {
             
-            std::cout << "[Task 4]  Candidate rejected by ILP (False positive).\n";
+            std::cout << "[Task 4]  All " << candidates.size() << " candidates rejected by ILP (False positive).\n";
         }
 #else
         std::cout << "[WARN] ILP not available. Accepting BDD result directly.\n";
@@ -574,7 +2536,6 @@ PetriNetAnalysis::DeadlockResult PetriNetAnalysis::DetectDeadlock(DdNode* reacha
         std::cout << "[Task 4] Intersection is empty. No deadlock reachable.\n";
     }
     
-    bdd_mgr.Deref(dead_mask);
     bdd_mgr.Deref(intersection);
 #else
     std::cout << "[WARN] CUDD not available for Task 4.\n";
@@ -586,6 +2547,96 @@ PetriNetAnalysis::DeadlockResult PetriNetAnalysis::DetectDeadlock(DdNode* reacha
     return result;
 }
 
+bool PetriNetAnalysis::FindDeadTransitions(DdNode* reachable_bdd, std::vector<int>& dead) {
+    dead.clear();
+#ifndef NO_CUDD
+    if (!reachable_bdd) return false;
+    bdd_mgr.ApplyBudget(budget);
+    bool ok = true;
+    for (size_t t = 0; t < transitions.size() && ok; ++t) {
+        DdNode* en = bdd_mgr.EnablingCondition((int)t, input_matrix);
+        // reach AND en is empty iff reach implies NOT en; no node is built
+        if (!en) ok = false;
+        else if (Cudd_bddLeq(bdd_mgr.manager, reachable_bdd, Cudd_Not(en))) dead.push_back((int)t);
+    }
+    bdd_mgr.ClearBudget();
+    if (!ok) dead.clear();
+    return ok;
+#else
+    return false;
+#endif
+}
+
+// Both fixpoints remove places until the condition holds, in time linear in
+// the arcs: per transition a count of its inputs (siphon) or outputs (trap)
+// still in the set.
+std::vector<char> PetriNetAnalysis::MaxSiphonIn(std::vector<char> set) const {
+    int T = (int)transitions.size();
+    std::vector<int> inputs_in(T, 0);
+    std::vector<int> queue;
+    // A transition with no input left in the set may not feed it
+    auto drop_outputs = [&](int t) {
+        for (int p : post_places[t]) if (set[p]) { set[p] = 0; queue.push_back(p); }
+    };
+    for (int t = 0; t < T; ++t) for (int p : pre_places[t]) inputs_in[t] += set[p];
+    for (int t = 0; t < T; ++t) if (inputs_in[t] == 0) drop_outputs(t);
+    while (!queue.empty()) {
+        int p = queue.back();
+        queue.pop_back();
+        for (int t : consumers[p]) if (--inputs_in[t] == 0) drop_outputs(t);
+    }
+    return set;
+}
+
+std::vector<char> PetriNetAnalysis::MaxTrapIn(std::vector<char> set) const {
+    int T = (int)transitions.size();
+    std::vector<int> outputs_in(T, 0);
+    std::vector<int> queue;
+    // A transition that puts nothing back in the set may not consume from it
+    auto drop_inputs = [&](int t) {
+        for (int p : pre_places[t]) if (set[p]) { set[p] = 0; queue.push_back(p); }
+    };
+    for (int t = 0; t < T; ++t) for (int p : post_places[t]) outputs_in[t] += set[p];
+    for (int t = 0; t < T; ++t) if (outputs_in[t] == 0) drop_inputs(t);
+    while (!queue.empty()) {
+        int p = queue.back();
+        queue.pop_back();
+        for (int t : producers[p]) if (--outputs_in[t] == 0) drop_inputs(t);
+    }
+    return set;
+}
+
+DdNode* PetriNetAnalysis::DeadlockSet(DdNode* reachable_bdd) {
+#ifndef NO_CUDD
+    if (!reachable_bdd) return nullptr;
+    DdNode* dead_mask = bdd_mgr.BuildDeadlockMask(input_matrix);
+    if (!dead_mask) return nullptr;
+    DdNode* intersection = Cudd_bddAnd(bdd_mgr.manager, reachable_bdd, dead_mask);
+    bdd_mgr.Ref(intersection);
+    bdd_mgr.Deref(dead_mask);
+    return intersection;
+#else
+    return nullptr;
+#endif
+}
+
+double PetriNetAnalysis::EnumerateDeadlocks(DdNode* reachable_bdd, size_t limit,
+                                            const std::function<bool(const Marking&)>& sink) {
+#ifndef NO_CUDD
+    bdd_mgr.ApplyBudget(budget);
+    DdNode* intersection = DeadlockSet(reachable_bdd);
+    bdd_mgr.ClearBudget();
+    if (!intersection) return -1;
+
+    double count = bdd_mgr.CountStates(intersection);
+    bdd_mgr.ForEachMarking(intersection, limit, sink);
+    bdd_mgr.Deref(intersection);
+    return count;
+#else
+    return -1;
+#endif
+}
+
 long long PetriNetAnalysis::GetTimeMs() const {
     auto now = std::chrono::steady_clock::now();
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
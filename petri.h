@@ -1,21 +1,87 @@
 #pragma once
 #include "main.h"
+#include <functional>
 
 #ifdef USE_GLPK
     #include <glpk.h>
 #endif
 
+// Token count of an omega-marking place that can grow without bound
+const int OMEGA = INT_MAX;
+
+// Per-run resource limits, 0 = unlimited. Engines check them in their main
+// loop and stop cleanly, keeping what they have computed so far.
+struct ResourceBudget {
+    size_t max_states;          // explicit / coverability states, symbolic minterms
+    size_t max_bdd_nodes;       // live BDD nodes (Cudd_SetMaxLive)
+    size_t max_bdd_memory_mb;   // CUDD memory (Cudd_SetMaxMemory)
+    long long time_limit_ms;    // wall clock per engine run
+    size_t max_rss_mb;          // resident set size of the process
+};
+
+// Statistics of an engine run; if aborted they describe the partial result
+struct RunStats {
+    bool aborted;
+    std::string reason;
+    double states;              // states (or minterms) found so far
+    size_t frontier;            // states still queued, or BDD nodes of the frontier
+    int depth;                  // BFS level / fixpoint iteration reached
+};
+
+// Budget check for hot loops: the state limit is tested on every call,
+// clock and RSS only every `period` calls
+class BudgetGuard {
+public:
+    BudgetGuard(const ResourceBudget& budget, unsigned period = 1024);
+    bool Exceeded(double states, RunStats& stats);
+    // Milliseconds left of the time limit since construction, LLONG_MAX if
+    // there is none; lets a multi-step engine charge every step to one deadline
+    long long RemainingMs() const;
+private:
+    const ResourceBudget& budget;
+    std::chrono::steady_clock::time_point start;
+    unsigned period, calls;
+};
+
 class BDDWrapper {
 private:
     
-    std::vector<DdNode*> x_vars;    // Current state variables
-    std::vector<DdNode*> xp_vars;   // Next state variables
+    // One (x, x') pair per slot. A plain place owns one slot; a block of
+    // places holding exactly one token between them shares ceil(log2 k)
+    // slots that store the code (index in the block) of the marked place.
+    std::vector<DdNode*> x_vars;    // Current state variables, per slot
+    std::vector<DdNode*> xp_vars;   // Next state variables, per slot
+    std::vector<int> var_place;     // BDD variable index -> plain place, -1 for x' and block bits
+    std::vector<int> var_slot;      // BDD variable index -> slot, -1 for x'
+    std::vector<int> place_slot;    // place -> slot, -1 if in a block
+    std::vector<int> place_block;   // place -> block, -1 if plain
+    std::vector<int> place_code;    // place -> code within its block
+    std::vector<std::vector<int>> blocks;       // block -> places, by code
+    std::vector<std::vector<int>> block_slots;  // block -> slots, low bit first
+    std::vector<DdNode*> marked;       // place -> "p holds a token" over x (referenced)
+    std::vector<DdNode*> marked_next;  // the same over x'
+    std::vector<DdNode*> enabling;  // per transition, see EnablingCondition
+
+    // Bits of one assignment (per slot) to a marking and back; Decode fails on
+    // a code past the end of its block, Encode on a marking with no valid code
+    bool Decode(const std::vector<char>& bits, Marking& m) const;
+    bool Encode(const Marking& m, std::vector<char>& bits) const;
+    // Slot of BDD variable `index`, or -1 for a next-state variable
+    int SlotOfVar(unsigned int index) const;
 
 public:
     BDDWrapper();
     ~BDDWrapper();
     DdManager* manager = nullptr;
-    void Init(int num_places);
+    // One variable pair per place; with `blocks` (disjoint place sets of which
+    // exactly one place is marked in every reachable marking) each block is
+    // encoded in binary instead
+    void Init(int num_places, const std::vector<std::vector<int>>& blocks = {});
+    size_t NumVars() const { return x_vars.size(); }
+    size_t NumBlocks() const { return blocks.size(); }
+    // "Place p holds a token" over the current (or next-state) variables;
+    // owned by the wrapper
+    DdNode* Marked(int p, bool next = false) const { return next ? marked_next[p] : marked[p]; }
     DdNode* BuildMarkingBDD(const Marking& m);
     
     // Constructs the global transition relation R(x, x')
@@ -24,15 +90,52 @@ public:
 
     // Computes Image(S) = Exists_x ( S(x) AND R(x, x') )
     DdNode* SymbolicImage(DdNode* current_bdd, DdNode* relation_bdd);
+    // Enabling condition of transition t (all input places marked), built once
+    // and owned by the wrapper; nullptr if a limit was hit
+    DdNode* EnablingCondition(int t, const std::vector<std::vector<int>>& input_matrix);
     DdNode* BuildDeadlockMask(const std::vector<std::vector<int>>& input_matrix);
+    // Markings from which firing t once lands in `set` (same 1-safe semantics
+    // as BuildTransitionRelation); referenced, nullptr if a limit was hit
+    DdNode* PreImage(DdNode* set, int t, const std::vector<std::vector<int>>& incidence,
+                     const std::vector<std::vector<int>>& input_matrix);
+    // ADD of sum_p c[p] * x_p over the current-state variables; the caller owns
+    // the returned reference (nullptr if a budget limit was hit)
+    DdNode* BuildObjectiveADD(const std::vector<int>& c);
+    // Any marking of the set, read off one path in O(depth)
     Marking PickOneMarking(DdNode* bdd);
+    // `count` markings drawn uniformly (with replacement) from a set over the
+    // current-state variables, weighting each branch by its minterm count
+    std::vector<Marking> SampleMarkings(DdNode* set, size_t count, uint64_t seed);
     double CountStates(DdNode* bdd);
+    // Streams the 0/1 markings of a set over the current-state variables, cube
+    // by cube, expanding don't-care variables. Stops after `limit` markings
+    // (0 = all) or when `sink` returns false; returns how many were emitted.
+    size_t ForEachMarking(DdNode* set, size_t limit, const std::function<bool(const Marking&)>& sink);
+
+    // Place encoded by BDD variable `index`, or -1 for a next-state variable
+    // or a block bit
+    int PlaceOfVar(unsigned int index) const;
+    // Plain places sorted by the level of their current-state variable, top
+    // first (block places are left out). Valid until the next reordering.
+    std::vector<int> PlacesByLevel();
+    // Membership of a 0/1 marking, by walking one path of `set`
+    bool Contains(DdNode* set, const Marking& m) const;
     DdNode* GetZero();
     DdNode* BDD_Or(DdNode* a, DdNode* b);
     DdNode* BDD_Minus(DdNode* a, DdNode* b);
     
     void Ref(DdNode* n);
     void Deref(DdNode* n);
+
+    // BDD limits of a budget stay active until ClearBudget(). Operations that
+    // hit one return nullptr; BudgetError() names the limit.
+    void ApplyBudget(const ResourceBudget& budget);
+    void ClearBudget();
+    std::string BudgetError();
+
+private:
+    unsigned int saved_max_live = 0;
+    size_t saved_max_memory = 0;
 };
 
 struct Place {
@@ -46,6 +149,128 @@ struct Transition {
     int index;
 };
 
+// States of an explicit exploration, each stored once in a flat token array
+// (num_places ints per state) and indexed by an open-addressing table on the
+// Zobrist hash. Ids are assigned in insertion order.
+class StateStore {
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    explicit StateStore(size_t num_places = 0);
+    size_t size() const { return hashes.size(); }
+    size_t NumPlaces() const { return num_places; }
+    const int* Data(uint32_t id) const { return tokens.data() + (size_t)id * num_places; }
+    Marking Get(uint32_t id) const { return Marking(Data(id), Data(id) + num_places); }
+    uint64_t Hash(uint32_t id) const { return hashes[id]; }
+
+    // Id of the state equal to `parent` changed by `delta`, or NONE
+    uint32_t FindSuccessor(uint64_t hash, uint32_t parent, const std::vector<std::pair<int, int>>& delta) const;
+    uint32_t Find(const Marking& m, uint64_t hash) const;
+    // Appends a state known to be absent
+    uint32_t Insert(const int* m, uint64_t hash);
+    // Appends `parent` changed by `delta`, without a temporary Marking
+    uint32_t InsertSuccessor(uint64_t hash, uint32_t parent, const std::vector<std::pair<int, int>>& delta);
+
+private:
+    size_t num_places;
+    std::vector<int> tokens;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> table;    // NONE = empty slot
+    void Grow();
+};
+
+// Reachability graph in CSR form: state s has the outgoing edges
+// [offsets[s], offsets[s+1]), edge e goes to targets[e] by firing labels[e].
+// State ids are the indices returned by ComputeExplicit (BFS order). After an
+// aborted run, states from `expanded` on were reached but not expanded and
+// have no edges.
+struct ReachabilityGraph {
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> labels;
+    size_t expanded = 0;
+
+    size_t NumStates() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t NumEdges() const { return targets.size(); }
+    // Binary layout: "PNRG", u32 version (2), u32 #states, u32 #expanded,
+    // u64 #edges, u64 offsets[#states + 1], u32 targets[#edges], u32 labels[#edges]
+    bool WriteBinary(const std::string& filename) const;
+    bool WriteDot(const std::string& filename, const std::vector<Place>& places,
+                  const std::vector<Transition>& transitions, const StateStore& states) const;
+};
+
+struct CoverabilityResult {
+    bool bounded;
+    std::vector<int> place_bounds;       // max tokens per place, OMEGA if unbounded
+    std::vector<int> unbounded_places;
+    std::vector<Marking> maximal;        // coverability set: every reachable marking is covered by one of these
+                                         // (left empty when composed from components)
+    size_t nodes;                        // Karp-Miller nodes built
+    long long time_ms;
+    RunStats stats;                      // if aborted, `bounded` is false only when omega was already found
+};
+
+// Bookkeeping of PetriNetAnalysis::ReduceNet(), from the reduced net back to
+// the parsed one. Original place p has m(p) = m(place_base[p]) + place_offset[p]
+// in the reduced marking m, or m(p) = place_offset[p] when place_base[p] = -1.
+struct NetReduction {
+    std::vector<std::string> place_ids;          // original ids
+    std::vector<char> place_kept;                // p survives as reduced place place_base[p]
+    std::vector<int> place_base;
+    std::vector<int> place_offset;
+    size_t num_places = 0;                       // places of the reduced net
+    std::vector<std::string> transition_ids;     // original ids
+    std::vector<std::vector<int>> transition_seq;  // per reduced transition: original firing sequence
+    int constant_places = 0, parallel_places = 0, fused_places = 0;
+    long long objective_offset = 0;              // objective_vector·m + this = original objective
+
+    bool Active() const { return !place_base.empty(); }
+    // Original marking of a reduced one (m itself when no reduction ran or m
+    // is not a reduced marking, e.g. an empty "nothing found")
+    Marking Expand(const Marking& m) const;
+    // Reduced marking of an original one; false if it contradicts the mapping
+    // (such a marking is not reachable)
+    bool Project(const Marking& orig, Marking& reduced) const;
+    // c over the original places as coefficients over the reduced ones:
+    // c·Expand(m) = result·m + offset
+    std::vector<int> MapObjective(const std::vector<int>& c, long long& offset) const;
+    // Original transitions behind reduced transition t, space separated
+    std::string TransitionLabel(int t, const std::string& reduced_id) const;
+};
+
+// Minimal-support semi-positive invariants. A P-invariant y satisfies
+// y·C = 0 (y·m is the same in every reachable marking), a T-invariant x
+// satisfies C·x = 0 (firing x returns to the same marking).
+struct InvariantResult {
+    std::vector<std::vector<std::pair<int, long long>>> invariants;  // sparse (index, weight), by index
+    std::vector<bool> covered;           // per place / transition: in the support of some invariant
+    long long time_ms;
+    RunStats stats;                      // if aborted (budget, overflow) the list is incomplete
+};
+
+// A connected component of the net: places and transitions linked by arcs,
+// as indices of the whole net
+struct NetComponent {
+    std::vector<int> places, transitions;
+};
+
+// Task 2 run on each component on its own. Components share nothing, so the
+// reachable set is the product of theirs: counts multiply, a marking is dead
+// iff each part is, and max c·m is the sum of the parts' maxima.
+struct ComponentResult {
+    std::vector<double> states;          // reachable markings per component
+    double total_states;                 // product of states
+    bool deadlock;                       // every component reaches a dead marking
+    bool deadlock_free;                  // some fully explored component has none
+    double deadlocks;                    // reachable dead markings, if deadlock
+    Marking deadlock_marking;            // a dead marking of each part, merged
+    long long optimum;                   // max c·m, exact unless stats.aborted
+    Marking optimum_marking;
+    std::vector<uint64_t> fired;         // as in ComputeExplicit
+    long long time_ms;
+    RunStats stats;                      // aborted if any component was; states = product
+};
+
 class PetriNetAnalysis {
 public:
     std::vector<Place> places;
@@ -56,26 +281,153 @@ public:
     
     Marking initial_marking;
     BDDWrapper bdd_mgr;
+    ResourceBudget budget = ResourceBudget();
 
     // Task 1
     bool ParsePNML(const std::string& filename);
     void PrintInfo() const;
+    // Structural reduction, applied in place until no rule matches:
+    // - constant place: its only arcs are self-loops and it starts marked (or
+    //   it has no arcs); it never changes and never disables anything
+    // - parallel places: same arcs as another place p and at least its initial
+    //   tokens, so m(q) = m(p) + k and q never disables anything p does not
+    // - series fusion (pre-agglomeration): p with m0 = 0, fed only by t1 and
+    //   consumed only by t2 whose only input is p; t2 is appended to t1 and p
+    //   dropped. Reachable markings become those with p empty, which keeps
+    //   deadlocks and dead transitions but not the bound of p (t2 may lag
+    //   behind t1), so boundedness is decided first. Skipped when firing t2
+    //   could lower one of `objectives` (over the original places), and
+    //   entirely when `exact` asks for the reachable set to stay in bijection.
+    // reduction maps results back; objective_vector is mapped as well.
+    void ReduceNet(const std::vector<std::vector<int>>& objectives, bool exact);
+    NetReduction reduction;
+    // Coverability (Karp-Miller), terminates on unbounded nets
+    CoverabilityResult ComputeCoverability() const;
+    // The same on each component (see FindComponents), place bounds merged
+    CoverabilityResult ComputeCoverability(const std::vector<NetComponent>& components, unsigned threads = 0) const;
+    // Farkas algorithm on sparse rows, eliminating one column at a time and
+    // dropping combinations whose support is not minimal. `budget` limits the
+    // number of intermediate rows (max_states) and time.
+    InvariantResult ComputePInvariants() const;
+    InvariantResult ComputeTInvariants() const;
+    // Disjoint place sets of 0/1 P-invariants carrying one token initially
+    // (state machines: exactly one place marked in every reachable marking),
+    // chosen greedily by size; each set is checked against C again
+    std::vector<std::vector<int>> OneTokenBlocks() const;
+
     // Task 2
-    bool IsEnabled(const Marking& m, int t_idx) const;
+    // Sparse arc lists per transition, rebuilt by BuildSparseArcs() after parsing
+    std::vector<std::vector<int>> pre_places;                    // places with input_matrix[p][t] > 0
+    std::vector<std::vector<int>> post_places;                   // places with an output arc from t
+    std::vector<std::vector<std::pair<int, int>>> delta_places;  // (place, incidence) with incidence != 0
+    std::vector<std::vector<int>> consumers;                     // per place: transitions that take from it
+    std::vector<std::vector<int>> producers;                     // per place: transitions that put into it
+    std::vector<std::vector<int>> affected;                      // per transition: consumers of the places it changes
+    std::vector<uint64_t> disabled_by;                           // per place: EnabledWords() words, consumers of that place
+    std::vector<uint64_t> all_transitions;                       // EnabledWords() words, one bit per transition
+    std::vector<char> full_update;                               // per transition: recomputing the whole set is cheaper
+    void BuildSparseArcs();
+
+    bool IsEnabled(const Marking& m, int t_idx) const { return IsEnabled(m.data(), t_idx); }
+    bool IsEnabled(const int* m, int t_idx) const;
     Marking Fire(const Marking& m, int t_idx) const;
-    std::set<Marking> ComputeExplicit(long long& time_ms) const;
+    // Zobrist hash: XOR of one key per (place, token count), updated in O(|delta(t)|) on firing
+    uint64_t HashMarking(const Marking& m) const;
+    uint64_t FireHash(const int* m, uint64_t hash, int t_idx) const;
+    // Enabled transitions as a bitset of EnabledWords() 64-bit words
+    size_t EnabledWords() const { return (transitions.size() + 63) / 64; }
+    void ComputeEnabledSet(const int* m, uint64_t* bits) const;
+    // Turns the parent's enabled set into the set of m = Fire(parent, t_idx) by re-checking affected[t_idx] only
+    void UpdateEnabledSet(const int* m, int t_idx, uint64_t* bits) const;
+    // Level-by-level BFS; state ids follow BFS order. If graph is given, the
+    // edges are recorded as well. Stops early (returning the states found so
+    // far) when `budget` is exceeded. If fired is given it receives, as
+    // EnabledWords() words, the transitions enabled in some reached state.
+    StateStore ComputeExplicit(long long& time_ms, ReachabilityGraph* graph = nullptr,
+                               RunStats* stats = nullptr, std::vector<uint64_t>* fired = nullptr) const;
+    // BFS that stops at `target`: 1 if reachable, 0 if not, -1 if `limits`
+    // (default: `budget`) ran out first
+    int ReachesMarking(const Marking& target, RunStats* stats = nullptr,
+                       const ResourceBudget* limits = nullptr) const;
+    // Best-first search for max c·m: states with the highest value are
+    // expanded first, and the search stops once the incumbent reaches
+    // `upper_bound`. `optimal` is set when that happened or the whole state
+    // space was explored within `budget`.
+    Marking ExploreMax(const std::vector<int>& c, long long upper_bound, long long& best_value,
+                       bool& optimal, RunStats* stats = nullptr) const;
+    // Connected components (union-find over arcs), ordered by their first place
+    // or transition. A transition without arcs is a component of its own.
+    std::vector<NetComponent> FindComponents() const;
+    // ComputeExplicit on each component as a separate net, `threads` at a time
+    // (0 = hardware concurrency); `budget` applies to each component. c is the
+    // Task 5 objective over the whole net.
+    ComponentResult AnalyzeComponents(const std::vector<NetComponent>& components, const std::vector<int>& c,
+                                      unsigned threads = 0) const;
 
-    // Task 3
-    DdNode* ComputeSymbolic(long long& time_ms);
     //Task 4
     struct DeadlockResult {
         bool found;
         Marking deadlock_marking;
         long long time_ms;
+        RunStats stats;
+        double count;           // reachable deadlocks, when the engine counts them
     };
+    // Task 3
+    // Under `budget` the fixpoint may stop early; the result is then the
+    // (under-approximated) set reached so far.
+    // With `early_deadlock`, each new frontier is intersected with the dead
+    // mask and the fixpoint stops at the first deadlock, reported with its BFS
+    // depth in stats.depth; stats->aborted then marks the set as partial.
+    DdNode* ComputeSymbolic(long long& time_ms, RunStats* stats = nullptr,
+                            DeadlockResult* early_deadlock = nullptr);
+    // Encode the places of OneTokenBlocks() in binary (fewer BDD variables)
+    bool compact_encoding = false;
+    // Onion rings of the last ComputeSymbolic run when keep_rings is set:
+    // ring k holds the markings first reached at BFS depth k (referenced)
+    bool keep_rings = false;
+    std::vector<DdNode*> onion_rings;
+    // Shortest firing sequence from the initial marking into `target`, rebuilt
+    // backwards over the rings with per-transition preimages. False if no
+    // ring meets the target.
+    bool ShortestTrace(DdNode* target, std::vector<int>& trace, Marking* end = nullptr);
+    // Transitions enabled in no marking of the (complete) reachable set, one
+    // implication test per cached enabling condition. False if a limit was hit.
+    bool FindDeadTransitions(DdNode* reachable_bdd, std::vector<int>& dead);
     DeadlockResult DetectDeadlock(DdNode* reachable_bdd);
+    // Counts the deadlocks in reachable_bdd and streams up to `limit` of them
+    // (0 = all) to `sink`. Returns -1 if a budget limit was hit.
+    double EnumerateDeadlocks(DdNode* reachable_bdd, size_t limit,
+                              const std::function<bool(const Marking&)>& sink);
 #ifdef USE_GLPK
+    // Max number of fireable transitions at m (x_t <= m_p for each input arc);
+    // 0 means m is dead. One model per net is kept across calls: a query only
+    // rewrites the bounds of rows whose place changed since the last one, and
+    // the simplex restarts from the previous basis.
     bool IsDeadlockByILP(const Marking& m);
+    // The same for a batch of candidates on that one model, in order (used by
+    // DetectDeadlock on the markings of the BDD candidate set)
+    std::vector<bool> AreDeadlocksByILP(const std::vector<Marking>& candidates);
+    // State equation m = m0 + C·sigma: columns 1..P are m (integer, capped by
+    // place_bounds when given), P+1..P+T are sigma, rows 1..P the equation.
+    // The objective is left to the caller.
+    glp_prob* BuildStateEquation(const std::vector<int>& place_bounds) const;
+    // Appends a row excluding the 0/1 assignment m of columns 1..m.size()
+    static void AddNoGoodCut(glp_prob* lp, const Marking& m);
+    // Whole-net check: state equation plus "every transition disabled".
+    // Infeasible proves deadlock freedom without any state space; a solution is
+    // confirmed on reachable_bdd (a complete reachable set) or by explicit
+    // search, and cut off if spurious. stats.aborted = inconclusive.
+    // place_bounds must come from a finished coverability run: lower caps
+    // could cut off a reachable dead marking.
+    DeadlockResult DetectDeadlockILP(const std::vector<int>& place_bounds, DdNode* reachable_bdd = nullptr,
+                                     int max_rounds = 100);
+    // Structural check, no state space: enumerates minimal siphons with an ILP
+    // (siphon constraints, no-good cut per siphon found) and tests that each
+    // holds an initially marked trap. With input arcs of weight 1 this
+    // siphon-trap property proves deadlock freedom on any net (for
+    // free-choice nets it is also necessary for liveness). found is always
+    // false; stats.aborted = not proven, stats.depth = siphons checked.
+    DeadlockResult CheckSiphonTrap(int max_siphons = 1000);
 #endif
 
     //Task 5
@@ -92,5 +444,26 @@ private:
     void CollectArcs(tinyxml2::XMLElement* root);
     bool VerifyConsistency(tinyxml2::XMLElement* root); 
     bool CheckArcs(tinyxml2::XMLElement* root);
+    // reachable_bdd AND dead mask, referenced; nullptr if a budget limit was hit
+    DdNode* DeadlockSet(DdNode* reachable_bdd);
+    // Largest siphon (•S ⊆ S•) / trap (S• ⊆ •S) inside `set`, as a place mask
+    std::vector<char> MaxSiphonIn(std::vector<char> set) const;
+    std::vector<char> MaxTrapIn(std::vector<char> set) const;
+    // Builds each component as a net of its own and runs job(index, subnet),
+    // `threads` components at a time (0 = hardware concurrency), largest first
+    void ForEachComponent(const std::vector<NetComponent>& components, unsigned threads,
+                          const std::function<void(size_t, const PetriNetAnalysis&)>& job) const;
 
+#ifdef USE_GLPK
+    glp_prob* deadlock_lp = nullptr;
+    std::vector<std::vector<int>> deadlock_rows;   // per place: rows x_t <= m_p
+    Marking deadlock_lp_marking;                    // marking the row bounds encode
+    void BuildDeadlockLP();
+#endif
+
+public:
+    PetriNetAnalysis() = default;
+    ~PetriNetAnalysis();
+    PetriNetAnalysis(const PetriNetAnalysis&) = delete;
+    PetriNetAnalysis& operator=(const PetriNetAnalysis&) = delete;
 };
\ No newline at end of file